@@ -0,0 +1,51 @@
+#include "alloccounter.h"
+#include <atomic>
+#include <cstddef>
+
+namespace {
+
+std::atomic<quint64> allocations(0);
+std::atomic<quint64> frees(0);
+
+} // namespace
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (!pointer) {
+    return __libc_malloc(size);
+  }
+  return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer) {
+  if (pointer) {
+    frees.fetch_add(1, std::memory_order_relaxed);
+  }
+  __libc_free(pointer);
+}
+
+} // extern "C"
+
+AllocCounter::Counts AllocCounter::counts() {
+  Counts counts;
+  counts.allocations = allocations.load(std::memory_order_relaxed);
+  counts.frees = frees.load(std::memory_order_relaxed);
+  return counts;
+}
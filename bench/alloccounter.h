@@ -0,0 +1,16 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include <QtGlobal>
+
+namespace AllocCounter
+{
+    struct Counts {
+        quint64 allocations = 0;
+        quint64 frees = 0;
+    };
+
+    Counts counts();
+}
+
+#endif
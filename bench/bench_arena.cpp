@@ -0,0 +1,111 @@
+#include "alloccounter.h"
+#include "benchutil.h"
+#include "storygenerator.h"
+#include "storyloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+struct Sample {
+  qint64 loadNs = 0;
+  quint64 loadAllocations = 0;
+  qint64 unloadNs = 0;
+  quint64 unloadFrees = 0;
+  int nodes = 0;
+  int choices = 0;
+};
+
+Sample measure(const QStringList &files, const StoryLoadOptions &options) {
+  Sample sample;
+  QElapsedTimer timer;
+
+  const AllocCounter::Counts beforeLoad = AllocCounter::counts();
+  timer.start();
+  LoadedStory story = StoryLoader::loadStory(files, options);
+  sample.loadNs = timer.nsecsElapsed();
+  sample.loadAllocations =
+      AllocCounter::counts().allocations - beforeLoad.allocations;
+
+  QSharedPointer<StoryGraph> graph = story.graph;
+  story = LoadedStory();
+  sample.nodes = graph->nodeCount();
+  sample.choices = graph->choiceCount();
+
+  const AllocCounter::Counts beforeUnload = AllocCounter::counts();
+  timer.restart();
+  graph.reset();
+  sample.unloadNs = timer.nsecsElapsed();
+  sample.unloadFrees = AllocCounter::counts().frees - beforeUnload.frees;
+  return sample;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Counts heap allocations and times loading and unloading story graphs.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Comma separated node counts.", "counts",
+                    "1000,10000,100000"});
+  parser.addOption({"text", "Node text length.", "chars", "400"});
+  parser.addOption({"files", "Number of chapter files.", "count", "4"});
+  parser.addOption({"threads", "Parser threads (0 = ideal).", "count", "1"});
+  parser.addOption({"streaming", "Use the streaming reader."});
+  parser.addOption({"iterations", "Timed loads per size.", "count", "5"});
+  parser.process(app);
+
+  StoryLoadOptions options;
+  options.threadCount = parser.value("threads").toInt();
+  options.streaming = parser.isSet("streaming");
+  const int iterations = qMax(1, parser.value("iterations").toInt());
+
+  QTextStream out(stdout);
+  out << "nodes    choices  load ms  load allocs  allocs/node  unload us  "
+         "unload frees\n";
+
+  const QStringList nodeCounts = parser.value("nodes").split(',');
+  for (const QString &nodeCount : nodeCounts) {
+    StoryShape shape;
+    shape.nodeCount = nodeCount.toInt();
+    shape.textLength = parser.value("text").toInt();
+    shape.fileCount = parser.value("files").toInt();
+
+    QTemporaryDir dir;
+    QString errorMsg;
+    const QStringList files =
+        StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+    if (!errorMsg.isEmpty()) {
+      QTextStream(stderr) << errorMsg << "\n";
+      return 1;
+    }
+
+    QVector<qint64> loadSamples;
+    QVector<qint64> unloadSamples;
+    Sample sample;
+    for (int i = 0; i < iterations; ++i) {
+      sample = measure(files, options);
+      loadSamples.append(sample.loadNs);
+      unloadSamples.append(sample.unloadNs);
+    }
+
+    out << QString("%1  %2  %3  %4  %5  %6  %7\n")
+               .arg(sample.nodes, -7)
+               .arg(sample.choices, 7)
+               .arg(BenchUtil::medianMs(loadSamples), 7, 'f', 1)
+               .arg(sample.loadAllocations, 11)
+               .arg(double(sample.loadAllocations) / qMax(1, sample.nodes), 11,
+                    'f', 1)
+               .arg(BenchUtil::medianMs(unloadSamples) * 1000.0, 9, 'f', 1)
+               .arg(sample.unloadFrees, 12);
+  }
+
+  return 0;
+}
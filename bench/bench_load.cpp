@@ -0,0 +1,117 @@
+#include "benchutil.h"
+#include "storycompiler.h"
+#include "storygenerator.h"
+#include "storyloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+qint64 loadThreePass(const QStringList &files) {
+  QElapsedTimer timer;
+  timer.start();
+
+  QString errorMsg;
+  QSharedPointer<StoryGraph> graph =
+      StoryLoader::loadFromMultipleJson(files, errorMsg);
+  StoryLoader::getStartNodeId(files.first(), errorMsg);
+  StoryLoader::getStoryTitle(files.first(), errorMsg);
+
+  return timer.nsecsElapsed();
+}
+
+qint64 loadSinglePass(const QStringList &files) {
+  QElapsedTimer timer;
+  timer.start();
+
+  StoryLoadOptions options;
+  options.compiled = false;
+  LoadedStory story = StoryLoader::loadStory(files, options);
+
+  return timer.nsecsElapsed();
+}
+
+qint64 loadCompiled(const QStringList &files) {
+  QElapsedTimer timer;
+  timer.start();
+
+  LoadedStory story = StoryLoader::loadStory(files);
+
+  return timer.nsecsElapsed();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Compares three-pass, single-pass and compiled story loading.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "20000"});
+  parser.addOption({"text", "Node text length.", "chars", "400"});
+  parser.addOption({"files", "Number of chapter files.", "count", "2"});
+  parser.addOption({"iterations", "Timed iterations.", "count", "5"});
+  parser.process(app);
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  shape.textLength = parser.value("text").toInt();
+  shape.fileCount = parser.value("files").toInt();
+  const int iterations = qMax(1, parser.value("iterations").toInt());
+
+  QTextStream out(stdout);
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  qint64 totalBytes = 0;
+  for (const QString &file : files) {
+    totalBytes += QFileInfo(file).size();
+  }
+
+  const QString compiledPath = StoryLoader::compiledStoryPath(files);
+  if (!StoryCompiler::compile(files, compiledPath, errorMsg)) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  QVector<qint64> threePass;
+  QVector<qint64> singlePass;
+  QVector<qint64> compiled;
+  for (int i = 0; i < iterations; ++i) {
+    threePass.append(loadThreePass(files));
+    singlePass.append(loadSinglePass(files));
+    compiled.append(loadCompiled(files));
+  }
+
+  const double threePassMs = BenchUtil::medianMs(threePass);
+  const double singlePassMs = BenchUtil::medianMs(singlePass);
+  const double compiledMs = BenchUtil::medianMs(compiled);
+  out << "story: " << shape.nodeCount << " nodes, " << files.size()
+      << " files, " << QString::number(totalBytes / 1048576.0, 'f', 2)
+      << " MB\n";
+  out << "three-pass load: " << QString::number(threePassMs, 'f', 2)
+      << " ms (median of " << iterations << ")\n";
+  out << "single-pass load: " << QString::number(singlePassMs, 'f', 2)
+      << " ms (median of " << iterations << ")\n";
+  out << "compiled load: " << QString::number(compiledMs, 'f', 2)
+      << " ms (median of " << iterations << ", "
+      << QString::number(QFileInfo(compiledPath).size() / 1048576.0, 'f', 2)
+      << " MB)\n";
+  out << "speedup: " << QString::number(threePassMs / singlePassMs, 'f', 2)
+      << "x single-pass, "
+      << QString::number(threePassMs / compiledMs, 'f', 2) << "x compiled\n";
+  return 0;
+}
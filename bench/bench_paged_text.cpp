@@ -0,0 +1,129 @@
+#include "benchutil.h"
+#include "storygenerator.h"
+#include "storyloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+namespace {
+
+int runChild(const QString &mode, const QStringList &files, int cacheBytes,
+             int reads) {
+  StoryLoadOptions options;
+  options.pagedText = mode == "paged";
+  options.textCacheBytes = cacheBytes;
+
+  const qint64 baseline = BenchUtil::currentRssBytes();
+  QElapsedTimer timer;
+  timer.start();
+  LoadedStory story = StoryLoader::loadStory(files, options);
+  const qint64 loadNs = timer.nsecsElapsed();
+  const qint64 loadedRss = BenchUtil::currentRssBytes();
+
+  const StoryGraph &graph = *story.graph;
+  quint64 state = 0x9e3779b97f4a7c15ull;
+  qint64 characters = 0;
+  timer.restart();
+  for (int i = 0; i < reads; ++i) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    const int node =
+        static_cast<int>((state >> 33) % quint64(graph.nodeCount()));
+    characters += graph.node(node).text().size();
+  }
+  const qint64 readNs = timer.nsecsElapsed();
+
+  QTextStream(stdout) << loadNs << " " << baseline << " " << loadedRss << " "
+                      << BenchUtil::peakRssBytes() << " " << readNs << " "
+                      << characters << "\n";
+  return story.hasErrors() ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Compares resident and paged node text storage.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "20000"});
+  parser.addOption({"text", "Node text length.", "chars", "4000"});
+  parser.addOption({"files", "Number of chapter files.", "count", "4"});
+  parser.addOption({"cache", "Paged text cache capacity.", "bytes",
+                    QString::number(StoryTextStore::DefaultCacheBytes)});
+  parser.addOption({"reads", "Random text() reads after loading.", "count",
+                    "100000"});
+  parser.addOption({"child", "Internal: load once in this mode.", "mode"});
+  parser.process(app);
+
+  const int cacheBytes = parser.value("cache").toInt();
+  const int reads = parser.value("reads").toInt();
+
+  if (parser.isSet("child")) {
+    return runChild(parser.value("child"), parser.positionalArguments(),
+                    cacheBytes, reads);
+  }
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  shape.textLength = parser.value("text").toInt();
+  shape.fileCount = parser.value("files").toInt();
+
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  qint64 totalBytes = 0;
+  for (const QString &file : files) {
+    totalBytes += QFileInfo(file).size();
+  }
+
+  QTextStream out(stdout);
+  out << "story: " << shape.nodeCount << " nodes, "
+      << QString::number(totalBytes / 1048576.0, 'f', 2) << " MB, cache "
+      << QString::number(cacheBytes / 1048576.0, 'f', 1) << " MB\n";
+  out << "mode      load ms  resident MB  peak MB  text() us\n";
+
+  for (const QString &mode : {QString("resident"), QString("paged")}) {
+    QStringList arguments = {"--child", mode, "--cache",
+                             QString::number(cacheBytes), "--reads",
+                             QString::number(reads)};
+    arguments += files;
+
+    QProcess child;
+    child.start(QCoreApplication::applicationFilePath(), arguments);
+    if (!child.waitForFinished(-1) || child.exitCode() != 0) {
+      QTextStream(stderr) << "Load failed in " << mode << " mode\n";
+      return 1;
+    }
+
+    const QList<QByteArray> fields =
+        child.readAllStandardOutput().trimmed().split(' ');
+    const double loadMs = fields.value(0).toLongLong() / 1e6;
+    const qint64 baseline = fields.value(1).toLongLong();
+    const double residentMb =
+        (fields.value(2).toLongLong() - baseline) / 1048576.0;
+    const double peakMb = (fields.value(3).toLongLong() - baseline) / 1048576.0;
+    const double readUs =
+        fields.value(4).toLongLong() / 1e3 / qMax(1, reads);
+
+    out << QString("%1  %2  %3  %4  %5\n")
+               .arg(mode, -8)
+               .arg(loadMs, 7, 'f', 1)
+               .arg(residentMb, 11, 'f', 1)
+               .arg(peakMb, 7, 'f', 1)
+               .arg(readUs, 9, 'f', 2);
+  }
+
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include "benchutil.h"
+#include "storygenerator.h"
+#include "storyloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+namespace {
+
+qint64 timedLoad(const QStringList &files, int threadCount) {
+  StoryLoadOptions options;
+  options.threadCount = threadCount;
+
+  QElapsedTimer timer;
+  timer.start();
+  LoadedStory story = StoryLoader::loadStory(files, options);
+  return timer.nsecsElapsed();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures multi-file story load throughput at 1 to N threads.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "100000"});
+  parser.addOption({"text", "Node text length.", "chars", "300"});
+  parser.addOption({"files", "Number of chapter files.", "count", "48"});
+  parser.addOption({"max-threads", "Highest thread count to measure.",
+                    "count", QString::number(QThread::idealThreadCount())});
+  parser.addOption({"iterations", "Timed iterations per thread count.",
+                    "count", "3"});
+  parser.process(app);
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  shape.textLength = parser.value("text").toInt();
+  shape.fileCount = parser.value("files").toInt();
+  const int maxThreads = qMax(1, parser.value("max-threads").toInt());
+  const int iterations = qMax(1, parser.value("iterations").toInt());
+
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  qint64 totalBytes = 0;
+  for (const QString &file : files) {
+    totalBytes += QFileInfo(file).size();
+  }
+  const double megabytes = totalBytes / 1048576.0;
+
+  QTextStream out(stdout);
+  out << "story: " << shape.nodeCount << " nodes, " << files.size()
+      << " files, " << QString::number(megabytes, 'f', 2) << " MB\n";
+  out << "threads  median ms  MB/s  speedup\n";
+
+  double baselineMs = 0.0;
+  for (int threads = 1; threads <= maxThreads; ++threads) {
+    QVector<qint64> samples;
+    for (int i = 0; i < iterations; ++i) {
+      samples.append(timedLoad(files, threads));
+    }
+    const double ms = BenchUtil::medianMs(samples);
+    if (threads == 1) {
+      baselineMs = ms;
+    }
+
+    out << QString("%1  %2  %3  %4x\n")
+               .arg(threads, 7)
+               .arg(ms, 9, 'f', 2)
+               .arg(megabytes / (ms / 1000.0), 6, 'f', 1)
+               .arg(baselineMs / ms, 6, 'f', 2);
+  }
+
+  return 0;
+}
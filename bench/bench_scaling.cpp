@@ -0,0 +1,195 @@
+#include "benchutil.h"
+#include "gameengine.h"
+#include "storygenerator.h"
+#include "storyloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+namespace {
+
+int runParseChild(const QStringList &files, const StoryLoadOptions &options) {
+  const qint64 baseline = BenchUtil::currentRssBytes();
+  QElapsedTimer timer;
+  timer.start();
+  LoadedStory story = StoryLoader::loadStory(files, options);
+  const qint64 parseNs = timer.nsecsElapsed();
+  const qint64 peak = BenchUtil::peakRssBytes();
+  const bool failed = story.hasErrors();
+  const int nodes = story.graph->nodeCount();
+  const int choices = story.graph->choiceCount();
+
+  timer.restart();
+  story = LoadedStory();
+  const qint64 unloadNs = timer.nsecsElapsed();
+
+  QTextStream(stdout) << parseNs << " " << unloadNs << " " << baseline << " "
+                      << peak << " " << nodes << " " << choices << "\n";
+  return failed ? 1 : 0;
+}
+
+int runEngineChild(const QStringList &files, const StoryLoadOptions &options) {
+  GameEngine engine;
+  engine.setLoadOptions(options);
+
+  bool failed = false;
+  QObject::connect(&engine, &GameEngine::errorOccurred,
+                   [&failed](const QString &) { failed = true; });
+
+  const qint64 baseline = BenchUtil::currentRssBytes();
+  QElapsedTimer timer;
+  timer.start();
+  engine.loadStoryFiles(files);
+  const qint64 loadNs = timer.nsecsElapsed();
+  const qint64 peak = BenchUtil::peakRssBytes();
+
+  timer.restart();
+  engine.unloadStory();
+  const qint64 clearNs = timer.nsecsElapsed();
+
+  QTextStream(stdout) << loadNs << " " << clearNs << " " << baseline << " "
+                      << peak << "\n";
+  return failed ? 1 : 0;
+}
+
+bool runChild(const QString &mode, const QStringList &files, int threadCount,
+              QList<QByteArray> &fields) {
+  QStringList arguments = {"--child", mode, "--threads",
+                           QString::number(threadCount)};
+  arguments += files;
+
+  QProcess child;
+  child.start(QCoreApplication::applicationFilePath(), arguments);
+  if (!child.waitForFinished(-1) || child.exitCode() != 0) {
+    return false;
+  }
+
+  fields = child.readAllStandardOutput().trimmed().split(' ');
+  return true;
+}
+
+double toMs(const QByteArray &nanoseconds) {
+  return nanoseconds.toLongLong() / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures story parse, engine load and clear costs across story sizes "
+      "and writes the results as JSON.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Comma separated node counts.", "counts",
+                    "1000,100000,1000000"});
+  parser.addOption({"choices", "Choices per node.", "count", "3"});
+  parser.addOption({"text", "Node text length.", "chars", "200"});
+  parser.addOption({"stats", "Stat changes per choice.", "count", "2"});
+  parser.addOption(
+      {"items", "Items per rewarding choice (every tenth).", "count", "1"});
+  parser.addOption({"files", "Number of chapter files.", "count", "4"});
+  parser.addOption({"threads", "Parser threads (0 = ideal).", "count", "0"});
+  parser.addOption({"output", "Write JSON here instead of stdout.", "file"});
+  parser.addOption({"child", "Internal: run one measurement.", "mode"});
+  parser.process(app);
+
+  const int threadCount = parser.value("threads").toInt();
+
+  if (parser.isSet("child")) {
+    StoryLoadOptions options;
+    options.threadCount = threadCount;
+    const QStringList files = parser.positionalArguments();
+    return parser.value("child") == "engine" ? runEngineChild(files, options)
+                                             : runParseChild(files, options);
+  }
+
+  QJsonArray results;
+  const QStringList nodeCounts = parser.value("nodes").split(',');
+  for (const QString &nodeCount : nodeCounts) {
+    StoryShape shape;
+    shape.nodeCount = nodeCount.toInt();
+    shape.choicesPerNode = parser.value("choices").toInt();
+    shape.textLength = parser.value("text").toInt();
+    shape.statsPerChoice = parser.value("stats").toInt();
+    shape.itemsPerChoice = parser.value("items").toInt();
+    shape.fileCount = parser.value("files").toInt();
+
+    QTemporaryDir dir;
+    QString errorMsg;
+    const QStringList files =
+        StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+    if (!errorMsg.isEmpty()) {
+      QTextStream(stderr) << errorMsg << "\n";
+      return 1;
+    }
+
+    qint64 totalBytes = 0;
+    for (const QString &file : files) {
+      totalBytes += QFileInfo(file).size();
+    }
+
+    QList<QByteArray> parse;
+    QList<QByteArray> engine;
+    if (!runChild("parse", files, threadCount, parse) ||
+        !runChild("engine", files, threadCount, engine)) {
+      QTextStream(stderr) << "Load failed for " << shape.nodeCount
+                          << " nodes\n";
+      return 1;
+    }
+
+    QJsonObject parseResult;
+    parseResult["parseMs"] = toMs(parse.value(0));
+    parseResult["unloadMs"] = toMs(parse.value(1));
+    parseResult["peakRssBytes"] =
+        parse.value(3).toLongLong() - parse.value(2).toLongLong();
+    parseResult["choices"] = parse.value(5).toInt();
+
+    QJsonObject engineResult;
+    engineResult["loadStoryMs"] = toMs(engine.value(0));
+    engineResult["clearStoryMs"] = toMs(engine.value(1));
+    engineResult["peakRssBytes"] =
+        engine.value(3).toLongLong() - engine.value(2).toLongLong();
+
+    QJsonObject result;
+    result["nodes"] = parse.value(4).toInt();
+    result["choicesPerNode"] = shape.choicesPerNode;
+    result["textLength"] = shape.textLength;
+    result["statsPerChoice"] = shape.statsPerChoice;
+    result["itemsPerChoice"] = shape.itemsPerChoice;
+    result["files"] = shape.fileCount;
+    result["bytes"] = totalBytes;
+    result["storyLoader"] = parseResult;
+    result["gameEngine"] = engineResult;
+    results.append(result);
+  }
+
+  QJsonObject report;
+  report["benchmark"] = "scaling";
+  report["qtVersion"] = QString(qVersion());
+  report["threads"] = threadCount;
+  report["results"] = results;
+  const QByteArray json = QJsonDocument(report).toJson();
+
+  if (parser.isSet("output")) {
+    QFile file(parser.value("output"));
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+      QTextStream(stderr) << "Failed to write " << parser.value("output")
+                          << "\n";
+      return 1;
+    }
+  } else {
+    QTextStream(stdout) << json;
+  }
+
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include "benchutil.h"
+#include "gameengine.h"
+#include "storygenerator.h"
+#include "storyloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures saved session size and save/restore latency for long "
+      "histories.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "5000"});
+  parser.addOption({"stats", "Stat changes per choice.", "count", "2"});
+  parser.addOption({"steps", "Choices to make.", "count", "100000"});
+  parser.addOption({"iterations", "Save/restore repetitions.", "count", "5"});
+  parser.process(app);
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  shape.statsPerChoice = parser.value("stats").toInt();
+  const int steps = qMax(1, parser.value("steps").toInt());
+  const int iterations = qMax(1, parser.value("iterations").toInt());
+
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  LoadedStory story = StoryLoader::loadStory(files);
+  GameEngine engine;
+  engine.setUndoMemoryLimit(0);
+  engine.loadStoryFiles(files);
+
+  int made = 0;
+  for (; made < steps; ++made) {
+    const int choice =
+        BenchUtil::continuingChoice(*story.graph, engine.currentNodeId(), made);
+    if (choice < 0) {
+      break;
+    }
+    engine.makeChoice(choice);
+  }
+
+  QByteArray saved;
+  QVector<qint64> saveSamples;
+  QElapsedTimer timer;
+  for (int i = 0; i < iterations; ++i) {
+    timer.start();
+    saved = engine.saveState();
+    saveSamples.append(timer.nsecsElapsed());
+  }
+
+  GameEngine restored;
+  restored.setUndoMemoryLimit(0);
+  restored.loadStoryFiles(files);
+
+  QVector<qint64> loadSamples;
+  for (int i = 0; i < iterations; ++i) {
+    timer.start();
+    if (!restored.loadState(saved, errorMsg)) {
+      QTextStream(stderr) << errorMsg << "\n";
+      return 1;
+    }
+    loadSamples.append(timer.nsecsElapsed());
+  }
+
+  if (restored.undoDepth() != engine.undoDepth() ||
+      restored.currentNodeId() != engine.currentNodeId()) {
+    QTextStream(stderr) << "Restored session does not match\n";
+    return 1;
+  }
+
+  QTextStream out(stdout);
+  out << "steps   depth   saved bytes  bytes/step  save ms  restore ms\n";
+  out << QString("%1  %2  %3  %4  %5  %6\n")
+             .arg(made, -6)
+             .arg(engine.undoDepth(), 6)
+             .arg(saved.size(), 11)
+             .arg(double(saved.size()) / qMax(1, made), 10, 'f', 2)
+             .arg(BenchUtil::medianMs(saveSamples), 7, 'f', 2)
+             .arg(BenchUtil::medianMs(loadSamples), 10, 'f', 2);
+  return 0;
+}
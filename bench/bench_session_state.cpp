@@ -0,0 +1,90 @@
+#include "benchutil.h"
+#include "sessionstate.h"
+#include "storygenerator.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures SessionState memory and transition throughput with many "
+      "live sessions.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "5000"});
+  parser.addOption({"stats", "Stat changes per choice.", "count", "2"});
+  parser.addOption({"sessions", "Live sessions.", "count", "100000"});
+  parser.addOption({"transitions", "Choices made in total.", "count",
+                    "10000000"});
+  parser.process(app);
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  shape.statsPerChoice = parser.value("stats").toInt();
+  const int sessionCount = qMax(1, parser.value("sessions").toInt());
+  const qint64 transitions =
+      qMax<qint64>(1, parser.value("transitions").toLongLong());
+
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  QSharedPointer<const Story> story =
+      Story::load(files, StoryLoadOptions(), errorMsg);
+  if (!story) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  const qint64 baseRss = BenchUtil::currentRssBytes();
+  QVector<SessionState> sessions(sessionCount);
+  for (SessionState &session : sessions) {
+    session.start(*story);
+  }
+
+  const StoryRules &rules = story->rules();
+  quint32 random = 1;
+  qint64 made = 0;
+  QElapsedTimer timer;
+  timer.start();
+  for (qint64 step = 0; step < transitions; ++step) {
+    SessionState &session = sessions[int(step % sessionCount)];
+    const int choices = rules.transitionCount(session.node);
+    if (choices == 0) {
+      session.start(*story);
+      continue;
+    }
+    random = random * 1664525u + 1013904223u;
+    if (session.makeChoice(*story, int((random >> 16) % quint32(choices)))) {
+      ++made;
+    }
+  }
+  const qint64 elapsedNs = timer.nsecsElapsed();
+  const qint64 sessionsRss = BenchUtil::currentRssBytes();
+
+  qint64 stateBytes = 0;
+  for (const SessionState &session : qAsConst(sessions)) {
+    stateBytes += session.memoryBytes();
+  }
+
+  QTextStream out(stdout);
+  out << "sessions  transitions  state bytes/session  rss bytes/session  "
+         "transitions/s\n";
+  out << QString("%1  %2  %3  %4  %5\n")
+             .arg(sessionCount, -8)
+             .arg(made, 11)
+             .arg(double(stateBytes) / sessionCount, 19, 'f', 0)
+             .arg(double(sessionsRss - baseRss) / sessionCount, 17, 'f', 0)
+             .arg(made / (elapsedNs / 1e9), 13, 'f', 0);
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include "benchutil.h"
+#include "gameengine.h"
+#include "storygenerator.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures memory for many GameEngine sessions sharing one story.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "20000"});
+  parser.addOption({"sessions", "Engines sharing the story.", "count",
+                    "10000"});
+  parser.addOption({"steps", "Choices made in each session.", "count", "20"});
+  parser.process(app);
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  const int sessions = qMax(1, parser.value("sessions").toInt());
+  const int steps = qMax(0, parser.value("steps").toInt());
+
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  const qint64 baseRss = BenchUtil::currentRssBytes();
+  QElapsedTimer timer;
+  timer.start();
+  QSharedPointer<const Story> story =
+      Story::load(files, StoryLoadOptions(), errorMsg);
+  const qint64 loadNs = timer.nsecsElapsed();
+  if (!story) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+  const qint64 storyRss = BenchUtil::currentRssBytes();
+
+  QVector<GameEngine *> engines;
+  engines.reserve(sessions);
+  timer.restart();
+  for (int session = 0; session < sessions; ++session) {
+    GameEngine *engine = new GameEngine;
+    engine->setStory(story);
+    for (int step = 0; step < steps; ++step) {
+      const int choices = engine->choices().size();
+      if (choices == 0) {
+        break;
+      }
+      engine->makeChoice((session + step) % choices);
+    }
+    engines.append(engine);
+  }
+  const qint64 sessionNs = timer.nsecsElapsed();
+  const qint64 sessionsRss = BenchUtil::currentRssBytes();
+
+  QTextStream out(stdout);
+  out << "sessions  story bytes  session bytes  bytes/session  load ms  "
+         "session us\n";
+  out << QString("%1  %2  %3  %4  %5  %6\n")
+             .arg(sessions, -8)
+             .arg(storyRss - baseRss, 11)
+             .arg(sessionsRss - storyRss, 13)
+             .arg(double(sessionsRss - storyRss) / sessions, 13, 'f', 0)
+             .arg(loadNs / 1e6, 7, 'f', 1)
+             .arg(sessionNs / 1e3 / sessions, 10, 'f', 2);
+
+  qDeleteAll(engines);
+  return 0;
+}
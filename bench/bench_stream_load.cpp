@@ -0,0 +1,92 @@
+#include "benchutil.h"
+#include "storygenerator.h"
+#include "storyloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+namespace {
+
+int runChild(const QString &mode, const QString &filePath) {
+  StoryLoadOptions options;
+  options.streaming = mode == "stream";
+
+  const qint64 baseline = BenchUtil::currentRssBytes();
+  QElapsedTimer timer;
+  timer.start();
+  LoadedStory story = StoryLoader::loadStory(QStringList(filePath), options);
+  const qint64 elapsed = timer.nsecsElapsed();
+  const qint64 peak = BenchUtil::peakRssBytes();
+
+  QTextStream(stdout) << elapsed << " " << baseline << " " << peak << " "
+                      << story.graph->nodeCount() << "\n";
+  return story.hasErrors() ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Compares peak RSS and parse speed of DOM and streaming story loads.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "50000"});
+  parser.addOption({"text", "Node text length.", "chars", "1000"});
+  parser.addOption({"child", "Internal: load once in this mode.", "mode"});
+  parser.addOption({"file", "Internal: story file for --child.", "path"});
+  parser.process(app);
+
+  if (parser.isSet("child")) {
+    return runChild(parser.value("child"), parser.value("file"));
+  }
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  shape.textLength = parser.value("text").toInt();
+
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  const double megabytes = QFileInfo(files.first()).size() / 1048576.0;
+  QTextStream out(stdout);
+  out << "story: " << shape.nodeCount << " nodes, "
+      << QString::number(megabytes, 'f', 2) << " MB\n";
+  out << "mode    parse ms  MB/s  peak RSS MB  load RSS MB\n";
+
+  for (const QString &mode : {QString("dom"), QString("stream")}) {
+    QProcess child;
+    child.start(QCoreApplication::applicationFilePath(),
+                {"--child", mode, "--file", files.first()});
+    if (!child.waitForFinished(-1) || child.exitCode() != 0) {
+      QTextStream(stderr) << "Load failed in " << mode << " mode\n";
+      return 1;
+    }
+
+    const QList<QByteArray> fields =
+        child.readAllStandardOutput().trimmed().split(' ');
+    const double ms = fields.value(0).toLongLong() / 1e6;
+    const double baselineMb = fields.value(1).toLongLong() / 1048576.0;
+    const double peakMb = fields.value(2).toLongLong() / 1048576.0;
+
+    out << QString("%1  %2  %3  %4  %5\n")
+               .arg(mode, -6)
+               .arg(ms, 8, 'f', 1)
+               .arg(megabytes / (ms / 1000.0), 6, 'f', 1)
+               .arg(peakMb, 11, 'f', 1)
+               .arg(peakMb - baselineMb, 11, 'f', 1);
+  }
+
+  return 0;
+}
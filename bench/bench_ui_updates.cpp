@@ -0,0 +1,123 @@
+#include "benchutil.h"
+#include "gameengine.h"
+#include "mainwindow.h"
+#include "storygenerator.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+class EventCounter : public QObject {
+public:
+  quint64 events = 0;
+
+protected:
+  bool eventFilter(QObject *watched, QEvent *event) override {
+    Q_UNUSED(watched);
+    Q_UNUSED(event);
+    ++events;
+    return false;
+  }
+};
+
+struct SignalCounts {
+  quint64 notify = 0;
+  quint64 stateChanged = 0;
+};
+
+void countSignals(GameEngine &engine, SignalCounts &counts) {
+  const QVector<void (GameEngine::*)()> notifySignals = {
+      &GameEngine::currentTextChanged, &GameEngine::choicesChanged,
+      &GameEngine::canGoBackChanged,   &GameEngine::statsChanged,
+      &GameEngine::inventoryChanged,   &GameEngine::choicesMadeChanged,
+      &GameEngine::nodesVisitedChanged, &GameEngine::playTimeChanged,
+      &GameEngine::endingsFoundChanged};
+  for (auto signal : notifySignals) {
+    QObject::connect(&engine, signal, [&counts]() { ++counts.notify; });
+  }
+  QObject::connect(&engine, &GameEngine::stateChanged,
+                   [&counts]() { ++counts.stateChanged; });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures engine notifications and window update work per choice.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "2000"});
+  parser.addOption({"choices", "Choices per node.", "count", "3"});
+  parser.addOption({"text", "Node text length.", "chars", "400"});
+  parser.addOption({"stats", "Stat changes per choice.", "count", "2"});
+  parser.addOption({"steps", "Choices to make.", "count", "1000"});
+  parser.process(app);
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  shape.choicesPerNode = parser.value("choices").toInt();
+  shape.textLength = parser.value("text").toInt();
+  shape.statsPerChoice = parser.value("stats").toInt();
+  const int steps = qMax(1, parser.value("steps").toInt());
+
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  GameEngine engine;
+  engine.setStoryFiles(files);
+  MainWindow window(&engine);
+  window.show();
+  app.processEvents();
+
+  SignalCounts counts;
+  countSignals(engine, counts);
+  EventCounter eventCounter;
+  app.installEventFilter(&eventCounter);
+
+  QVector<qint64> samples;
+  samples.reserve(steps);
+  QElapsedTimer timer;
+  for (int step = 0; step < steps; ++step) {
+    if (engine.isGameEnded() || engine.choices().isEmpty()) {
+      app.removeEventFilter(&eventCounter);
+      const SignalCounts before = counts;
+      engine.restart();
+      app.processEvents();
+      counts = before;
+      app.installEventFilter(&eventCounter);
+    }
+
+    const int choiceCount = engine.choices().size();
+    timer.start();
+    engine.makeChoice(step % qMax(1, choiceCount));
+    app.processEvents();
+    samples.append(timer.nsecsElapsed());
+  }
+  app.removeEventFilter(&eventCounter);
+
+  QTextStream out(stdout);
+  out << "steps  notify/choice  stateChanged/choice  events/choice  "
+         "median us\n";
+  out << QString("%1  %2  %3  %4  %5\n")
+             .arg(steps, -5)
+             .arg(double(counts.notify) / steps, 13, 'f', 2)
+             .arg(double(counts.stateChanged) / steps, 19, 'f', 2)
+             .arg(double(eventCounter.events) / steps, 13, 'f', 1)
+             .arg(BenchUtil::medianMs(samples) * 1000.0, 9, 'f', 1);
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include "benchutil.h"
+#include "gameengine.h"
+#include "storygenerator.h"
+#include "storyloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures undo history memory and restore cost over long sessions.");
+  parser.addHelpOption();
+  parser.addOption({"nodes", "Generated node count.", "count", "5000"});
+  parser.addOption({"stats", "Stat changes per choice.", "count", "2"});
+  parser.addOption({"steps", "Choices to make.", "count", "10000"});
+  parser.addOption({"limit", "Undo memory limit (0 = unlimited).", "bytes",
+                    "0"});
+  parser.process(app);
+
+  StoryShape shape;
+  shape.nodeCount = parser.value("nodes").toInt();
+  shape.statsPerChoice = parser.value("stats").toInt();
+  const int steps = qMax(1, parser.value("steps").toInt());
+
+  QTemporaryDir dir;
+  QString errorMsg;
+  const QStringList files =
+      StoryGenerator::writeStory(dir.path(), shape, errorMsg);
+  if (!errorMsg.isEmpty()) {
+    QTextStream(stderr) << errorMsg << "\n";
+    return 1;
+  }
+
+  LoadedStory story = StoryLoader::loadStory(files);
+  GameEngine engine;
+  engine.setUndoMemoryLimit(parser.value("limit").toLongLong());
+  engine.loadStoryFiles(files);
+
+  QElapsedTimer timer;
+  timer.start();
+  int made = 0;
+  for (; made < steps; ++made) {
+    const int choice =
+        BenchUtil::continuingChoice(*story.graph, engine.currentNodeId(), made);
+    if (choice < 0) {
+      break;
+    }
+    engine.makeChoice(choice);
+  }
+  const qint64 choiceNs = timer.nsecsElapsed();
+
+  const int depth = engine.undoDepth();
+  const qint64 bytes = engine.undoMemoryBytes();
+
+  QVector<qint64> samples;
+  samples.reserve(depth);
+  while (engine.canGoBack()) {
+    timer.restart();
+    engine.goBack();
+    samples.append(timer.nsecsElapsed());
+  }
+
+  QTextStream out(stdout);
+  out << "steps   depth   undo bytes  bytes/step  bytes/10k steps  "
+         "choice us  goBack us\n";
+  out << QString("%1  %2  %3  %4  %5  %6  %7\n")
+             .arg(made, -6)
+             .arg(depth, 6)
+             .arg(bytes, 11)
+             .arg(double(bytes) / qMax(1, depth), 10, 'f', 1)
+             .arg(double(bytes) / qMax(1, depth) * 10000.0, 15, 'f', 0)
+             .arg(choiceNs / 1000.0 / qMax(1, made), 9, 'f', 2)
+             .arg(BenchUtil::medianMs(samples) * 1000.0, 9, 'f', 2);
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "benchutil.h"
+#include "storygraph.h"
+#include <QFile>
+#include <algorithm>
+
+namespace {
+
+qint64 procStatusBytes(const QByteArray &field) {
+  QFile status("/proc/self/status");
+  if (!status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    return -1;
+  }
+
+  while (!status.atEnd()) {
+    const QByteArray line = status.readLine();
+    if (line.startsWith(field + ':')) {
+      const QByteArray kilobytes =
+          line.mid(field.size() + 1).trimmed().split(' ').value(0);
+      return kilobytes.toLongLong() * 1024;
+    }
+  }
+  return -1;
+}
+
+} // namespace
+
+qint64 BenchUtil::currentRssBytes() { return procStatusBytes("VmRSS"); }
+
+qint64 BenchUtil::peakRssBytes() { return procStatusBytes("VmHWM"); }
+
+double BenchUtil::medianMs(QVector<qint64> nanoseconds) {
+  if (nanoseconds.isEmpty()) {
+    return 0.0;
+  }
+  std::sort(nanoseconds.begin(), nanoseconds.end());
+  return nanoseconds[nanoseconds.size() / 2] / 1e6;
+}
+
+int BenchUtil::continuingChoice(const StoryGraph &graph, const QString &nodeId,
+                                int step) {
+  const int node = graph.findNode(nodeId);
+  if (node < 0) {
+    return -1;
+  }
+
+  const StoryNode &current = graph.node(node);
+  for (int i = 0; i < current.choiceCount(); ++i) {
+    const int choice = (step + i) % current.choiceCount();
+    const int target = current.choice(choice).targetNode();
+    if (target >= 0 && !graph.node(target).isEndNode()) {
+      return choice;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,18 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+class StoryGraph;
+
+namespace BenchUtil
+{
+    qint64 currentRssBytes();
+    qint64 peakRssBytes();
+    double medianMs(QVector<qint64> nanoseconds);
+    int continuingChoice(const StoryGraph &graph, const QString &nodeId, int step);
+}
+
+#endif
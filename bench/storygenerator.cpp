@@ -0,0 +1,139 @@
+#include "storygenerator.h"
+#include <QDir>
+#include <QFile>
+
+namespace {
+
+const char *const Words[] = {"the",    "cultivator", "walks",  "through",
+                             "mist",   "of",         "jade",   "mountains",
+                             "where",  "ancient",    "spirit", "beasts",
+                             "guard",  "forgotten",  "sects",  "and",
+                             "silent", "rivers",     "carry",  "starlight"};
+
+const int WordCount = sizeof(Words) / sizeof(Words[0]);
+
+const char *const Stats[] = {"strength", "wisdom", "intelligence", "health",
+                             "fortune"};
+
+const int StatNameCount = sizeof(Stats) / sizeof(Stats[0]);
+
+QByteArray nodeId(int index) { return "node_" + QByteArray::number(index); }
+
+QByteArray statName(int index) {
+  return index < StatNameCount ? QByteArray(Stats[index])
+                               : "stat_" + QByteArray::number(index);
+}
+
+QByteArray statValue(int stat, int node, int choice) {
+  switch (stat) {
+  case 0:
+    return QByteArray::number(choice % 3);
+  case 1:
+    return QByteArray::number(1 - choice % 2);
+  default:
+    return QByteArray::number((node + choice + stat) % 5 - 2);
+  }
+}
+
+QByteArray nodeText(int index, int length) {
+  QByteArray text;
+  text.reserve(length + 16);
+  int word = index % WordCount;
+  while (text.size() < length) {
+    if (!text.isEmpty()) {
+      text += ' ';
+    }
+    text += Words[word];
+    word = (word * 7 + 3) % WordCount;
+  }
+  text.truncate(length);
+  return text;
+}
+
+} // namespace
+
+QStringList StoryGenerator::writeStory(const QString &directory,
+                                       const StoryShape &shape,
+                                       QString &errorMsg) {
+  QStringList filePaths;
+  errorMsg.clear();
+
+  QDir dir(directory);
+  for (int fileIndex = 0; fileIndex < shape.fileCount; ++fileIndex) {
+    const QString filePath =
+        dir.filePath(QString("story_part%1.json").arg(fileIndex + 1));
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+      errorMsg = "Failed to write generated story file: " + filePath;
+      return QStringList();
+    }
+
+    file.write(storyFileJson(shape, fileIndex));
+    filePaths.append(filePath);
+  }
+
+  return filePaths;
+}
+
+QByteArray StoryGenerator::storyFileJson(const StoryShape &shape,
+                                         int fileIndex) {
+  const int fileCount = qMax(1, shape.fileCount);
+  const int nodesPerFile = (shape.nodeCount + fileCount - 1) / fileCount;
+  const int firstNode = fileIndex * nodesPerFile;
+  const int lastNode = qMin(shape.nodeCount, firstNode + nodesPerFile);
+  const int endingStart = shape.nodeCount - qMax(1, shape.nodeCount / 20);
+
+  QByteArray json;
+  json += "{\n  \"story\": {\n";
+  json += "    \"title\": \"Generated Story\",\n";
+  json += "    \"startNode\": \"node_0\",\n";
+  if (fileIndex == 0) {
+    json += "    \"stats\": [";
+    for (int stat = 0; stat < qMax(StatNameCount, shape.statsPerChoice);
+         ++stat) {
+      json += stat == 0 ? "\n" : ",\n";
+      json += "      {\"id\": \"" + statName(stat) + "\", \"initial\": 10}";
+    }
+    json += "\n    ],\n";
+  }
+  json += "    \"nodes\": [\n";
+
+  for (int node = firstNode; node < lastNode; ++node) {
+    json += "      {\n        \"id\": \"" + nodeId(node) + "\",\n";
+    json += "        \"text\": \"" + nodeText(node, shape.textLength) + "\",\n";
+    json += "        \"choices\": [";
+
+    const int choiceCount = node >= endingStart ? 0 : shape.choicesPerNode;
+    for (int choice = 0; choice < choiceCount; ++choice) {
+      const int target =
+          (node + 1 + choice * (shape.nodeCount / (choice + 2) + 1)) %
+          shape.nodeCount;
+      json += choice == 0 ? "\n" : ",\n";
+      json += "          {\n";
+      json += "            \"text\": \"Choice " + QByteArray::number(choice) +
+              " from " + nodeId(node) + "\",\n";
+      json += "            \"target\": \"" + nodeId(target) + "\",\n";
+      json += "            \"stats\": {";
+      for (int stat = 0; stat < shape.statsPerChoice; ++stat) {
+        json += stat == 0 ? "\"" : ", \"";
+        json += statName(stat) + "\": " + statValue(stat, node, choice);
+      }
+      json += "},\n";
+      json += "            \"items\": [";
+      if ((node + choice) % 10 == 0) {
+        for (int item = 0; item < shape.itemsPerChoice; ++item) {
+          json += item == 0 ? "\"Item " : ", \"Item ";
+          json += QByteArray::number((node + choice + item) % 97) + "\"";
+        }
+      }
+      json += "]\n          }";
+    }
+
+    json += choiceCount > 0 ? "\n        ]\n      }" : "]\n      }";
+    json += node + 1 < lastNode ? ",\n" : "\n";
+  }
+
+  json += "    ]\n  }\n}\n";
+  return json;
+}
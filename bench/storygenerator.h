@@ -0,0 +1,24 @@
+#ifndef STORYGENERATOR_H
+#define STORYGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+struct StoryShape {
+    int nodeCount = 1000;
+    int choicesPerNode = 3;
+    int textLength = 400;
+    int statsPerChoice = 2;
+    int itemsPerChoice = 1;
+    int fileCount = 1;
+};
+
+class StoryGenerator
+{
+public:
+    static QStringList writeStory(const QString &directory, const StoryShape &shape, QString &errorMsg);
+    static QByteArray storyFileJson(const StoryShape &shape, int fileIndex);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "bitset.h"
+#include <QtAlgorithms>
+
+Bitset Bitset::fromWords(const QVector<quint64> &words) {
+  Bitset bitset;
+  int size = words.size();
+  while (size > 0 && words[size - 1] == 0) {
+    --size;
+  }
+  bitset.m_words = words.mid(0, size);
+  for (quint64 word : qAsConst(bitset.m_words)) {
+    bitset.m_count += qPopulationCount(word);
+  }
+  return bitset;
+}
+
+bool Bitset::test(int bit) const {
+  const int word = bit >> 6;
+  return bit >= 0 && word < m_words.size() &&
+         (m_words.constData()[word] >> (bit & 63)) & 1;
+}
+
+bool Bitset::set(int bit) {
+  if (bit < 0) {
+    return false;
+  }
+
+  const int word = bit >> 6;
+  if (word >= m_words.size()) {
+    m_words.resize(word + 1);
+  }
+  quint64 &value = m_words[word];
+  const quint64 mask = quint64(1) << (bit & 63);
+  if (value & mask) {
+    return false;
+  }
+  value |= mask;
+  ++m_count;
+  return true;
+}
+
+bool Bitset::reset(int bit) {
+  if (!test(bit)) {
+    return false;
+  }
+
+  m_words[bit >> 6] &= ~(quint64(1) << (bit & 63));
+  --m_count;
+  return true;
+}
+
+void Bitset::clear() {
+  m_words.clear();
+  m_count = 0;
+}
+
+int Bitset::count() const { return m_count; }
+
+bool Bitset::isEmpty() const { return m_count == 0; }
+
+int Bitset::nextSetBit(int from) const {
+  int word = qMax(0, from) >> 6;
+  if (word >= m_words.size()) {
+    return -1;
+  }
+
+  quint64 value = m_words[word] & (~quint64(0) << (qMax(0, from) & 63));
+  while (value == 0) {
+    if (++word >= m_words.size()) {
+      return -1;
+    }
+    value = m_words[word];
+  }
+  return (word << 6) + qCountTrailingZeroBits(value);
+}
+
+const QVector<quint64> &Bitset::words() const { return m_words; }
+
+qint64 Bitset::memoryBytes() const {
+  return m_words.capacity() * qint64(sizeof(quint64));
+}
@@ -0,0 +1,31 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <QVector>
+#include <QtGlobal>
+
+class Bitset
+{
+public:
+    Bitset() = default;
+
+    static Bitset fromWords(const QVector<quint64> &words);
+
+    bool test(int bit) const;
+    bool set(int bit);
+    bool reset(int bit);
+    void clear();
+
+    int count() const;
+    bool isEmpty() const;
+    int nextSetBit(int from) const;
+
+    const QVector<quint64> &words() const;
+    qint64 memoryBytes() const;
+
+private:
+    QVector<quint64> m_words;
+    int m_count = 0;
+};
+
+#endif
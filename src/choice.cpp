@@ -1,27 +1,50 @@
 #include "choice.h"
+#include "storygraph.h"
 
-Choice::Choice(const QString &text, const QString &targetNodeId,
-               const QMap<QString, int> &statChanges, const QStringList &itemsGained)
-    : m_text(text), m_targetNodeId(targetNodeId), m_statChanges(statChanges), m_itemsGained(itemsGained)
+QString Choice::text() const
 {
+    return m_graph->string(m_text);
 }
 
-QString Choice::text() const
+QString Choice::targetNodeId() const
 {
-    return m_text;
+    return m_graph->string(m_targetNodeId);
 }
 
-QString Choice::targetNodeId() const
+int Choice::targetNode() const
 {
-    return m_targetNodeId;
+    return m_targetNode;
 }
 
 QMap<QString, int> Choice::statChanges() const
 {
-    return m_statChanges;
+    QMap<QString, int> statChanges;
+    for (int i = 0; i < m_statCount; ++i) {
+        const int stat = m_firstStat + i;
+        statChanges.insert(m_graph->string(m_graph->m_statNames[stat]),
+                           m_graph->m_statDeltas[stat].delta);
+    }
+    return statChanges;
 }
 
 QStringList Choice::itemsGained() const
 {
-    return m_itemsGained;
+    QStringList itemsGained;
+    itemsGained.reserve(m_itemCount);
+    for (int i = 0; i < m_itemCount; ++i) {
+        itemsGained.append(m_graph->string(m_graph->m_itemNames[m_firstItem + i]));
+    }
+    return itemsGained;
+}
+
+ConstSpan<StatDelta> Choice::statDeltas() const
+{
+    return ConstSpan<StatDelta>(m_graph->m_statDeltas.constData() + m_firstStat,
+                                m_statCount);
+}
+
+ConstSpan<int> Choice::itemSymbols() const
+{
+    return ConstSpan<int>(m_graph->m_itemSymbols.constData() + m_firstItem,
+                          m_itemCount);
 }
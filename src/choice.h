@@ -4,24 +4,49 @@
 #include <QString>
 #include <QMap>
 #include <QStringList>
+#include "constspan.h"
+
+class StoryGraph;
+
+struct StatDelta {
+    int stat;
+    int delta;
+};
+
+struct StoryStringRef {
+    int offset = 0;
+    int length = 0;
+};
 
 class Choice
 {
 public:
-    Choice(const QString &text, const QString &targetNodeId,
-           const QMap<QString, int> &statChanges = QMap<QString, int>(),
-           const QStringList &itemsGained = QStringList());
+    Choice() = default;
 
     QString text() const;
     QString targetNodeId() const;
+    int targetNode() const;
     QMap<QString, int> statChanges() const;
     QStringList itemsGained() const;
 
+    ConstSpan<StatDelta> statDeltas() const;
+    ConstSpan<int> itemSymbols() const;
+
 private:
-    QString m_text;
-    QString m_targetNodeId;
-    QMap<QString, int> m_statChanges;
-    QStringList m_itemsGained;
+    friend class StoryGraph;
+
+    const StoryGraph *m_graph = nullptr;
+    StoryStringRef m_text;
+    StoryStringRef m_targetNodeId;
+    int m_targetNode = -1;
+    int m_firstStat = 0;
+    int m_statCount = 0;
+    int m_firstItem = 0;
+    int m_itemCount = 0;
 };
 
+Q_DECLARE_TYPEINFO(StatDelta, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(StoryStringRef, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(Choice, Q_PRIMITIVE_TYPE);
+
 #endif
@@ -0,0 +1,474 @@
+#include "compiledstory.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+namespace {
+
+bool sectionFits(quint32 offset, quint32 count, quint32 recordSize,
+                 quint32 fileSize) {
+  if (offset < sizeof(StoryFormat::Header) || offset % 4 != 0) {
+    return false;
+  }
+  return quint64(offset) + quint64(count) * recordSize <= fileSize;
+}
+
+bool rangeFits(quint32 first, quint32 count, quint32 total) {
+  return quint64(first) + count <= total;
+}
+
+int compareUtf16(const QChar *lhs, int lhsLength, const QChar *rhs,
+                 int rhsLength) {
+  const int length = qMin(lhsLength, rhsLength);
+  for (int i = 0; i < length; ++i) {
+    if (lhs[i].unicode() != rhs[i].unicode()) {
+      return lhs[i].unicode() < rhs[i].unicode() ? -1 : 1;
+    }
+  }
+  if (lhsLength == rhsLength) {
+    return 0;
+  }
+  return lhsLength < rhsLength ? -1 : 1;
+}
+
+bool fileChecksum(const QString &filePath, quint32 &checksum) {
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  const QByteArray data = file.readAll();
+  checksum = StoryFormat::checksum(data.constData(), data.size());
+  return true;
+}
+
+QString relativeSourcePath(const QString &compiledPath,
+                           const QString &filePath) {
+  const QDir directory = QFileInfo(compiledPath).absoluteDir();
+  return directory.relativeFilePath(QFileInfo(filePath).absoluteFilePath());
+}
+
+} // namespace
+
+bool CompiledStory::describeSource(const QString &compiledPath,
+                                   const QString &sourcePath,
+                                   CompiledSource &source,
+                                   QString &errorMsg) {
+  const QFileInfo info(sourcePath);
+  if (!info.isFile() || info.size() > 0xffffffffLL ||
+      !fileChecksum(sourcePath, source.checksum)) {
+    errorMsg = "Failed to read story file: " + sourcePath;
+    return false;
+  }
+
+  source.path = relativeSourcePath(compiledPath, sourcePath);
+  source.size = info.size();
+  source.modified = info.lastModified().toMSecsSinceEpoch();
+  return true;
+}
+
+CompiledStory::CompiledStory()
+    : m_data(nullptr), m_header(nullptr), m_nodes(nullptr),
+      m_choices(nullptr), m_stats(nullptr), m_items(nullptr),
+      m_statDefinitions(nullptr), m_itemDefinitions(nullptr),
+      m_effects(nullptr), m_sources(nullptr), m_strings(nullptr) {}
+
+CompiledStory::~CompiledStory() { close(); }
+
+bool CompiledStory::open(const QString &filePath, QString &errorMsg) {
+  close();
+  errorMsg.clear();
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+  errorMsg = "Compiled stories are not supported on big-endian hosts";
+  return false;
+#endif
+
+  m_file.setFileName(filePath);
+  if (!m_file.open(QIODevice::ReadOnly)) {
+    errorMsg = "Failed to open compiled story: " + filePath;
+    return false;
+  }
+
+  const qint64 size = m_file.size();
+  if (size < qint64(sizeof(StoryFormat::Header)) || size > 0xffffffffLL) {
+    errorMsg = "Invalid compiled story size: " + filePath;
+    close();
+    return false;
+  }
+
+  m_data = m_file.map(0, size);
+  if (!m_data) {
+    errorMsg = "Failed to map compiled story: " + filePath;
+    close();
+    return false;
+  }
+
+  m_header = reinterpret_cast<const StoryFormat::Header *>(m_data);
+  if (m_header->magic != StoryFormat::Magic) {
+    errorMsg = "Not a compiled story file: " + filePath;
+    close();
+    return false;
+  }
+
+  if (m_header->version != StoryFormat::Version) {
+    errorMsg = QString("Unsupported compiled story version %1 in %2; "
+                       "recompile it with rencpp-storyc")
+                   .arg(m_header->version)
+                   .arg(filePath);
+    close();
+    return false;
+  }
+
+  if (m_header->fileSize != quint64(size)) {
+    errorMsg = "Compiled story is truncated: " + filePath;
+    close();
+    return false;
+  }
+
+  const char *body = reinterpret_cast<const char *>(m_data) +
+                     sizeof(StoryFormat::Header);
+  if (StoryFormat::checksum(body, size - sizeof(StoryFormat::Header)) !=
+      m_header->checksum) {
+    errorMsg = "Checksum mismatch in compiled story: " + filePath;
+    close();
+    return false;
+  }
+
+  if (!validate(errorMsg)) {
+    errorMsg += ": " + filePath;
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void CompiledStory::close() {
+  if (m_data) {
+    m_file.unmap(m_data);
+  }
+  if (m_file.isOpen()) {
+    m_file.close();
+  }
+
+  m_data = nullptr;
+  m_header = nullptr;
+  m_nodes = nullptr;
+  m_choices = nullptr;
+  m_stats = nullptr;
+  m_items = nullptr;
+  m_statDefinitions = nullptr;
+  m_itemDefinitions = nullptr;
+  m_effects = nullptr;
+  m_sources = nullptr;
+  m_strings = nullptr;
+}
+
+bool CompiledStory::isOpen() const { return m_data != nullptr; }
+
+QString CompiledStory::title() const {
+  if (!isOpen()) {
+    return QString();
+  }
+  return string(m_header->title);
+}
+
+QString CompiledStory::startNodeId() const {
+  if (!isOpen()) {
+    return QString();
+  }
+  return string(m_header->startNode);
+}
+
+int CompiledStory::nodeCount() const {
+  return isOpen() ? static_cast<int>(m_header->nodeCount) : 0;
+}
+
+int CompiledStory::findNode(const QString &id) const {
+  int low = 0;
+  int high = nodeCount() - 1;
+
+  while (low <= high) {
+    const int middle = low + (high - low) / 2;
+    const StoryFormat::StringRef &ref = m_nodes[middle].id;
+    const int order = compareUtf16(m_strings + ref.offset,
+                                   static_cast<int>(ref.length),
+                                   id.constData(), id.size());
+    if (order == 0) {
+      return middle;
+    }
+    if (order < 0) {
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  return -1;
+}
+
+QString CompiledStory::nodeId(int node) const {
+  return string(m_nodes[node].id);
+}
+
+QString CompiledStory::nodeText(int node) const {
+  return string(m_nodes[node].text);
+}
+
+bool CompiledStory::isEndNode(int node) const {
+  return m_nodes[node].choiceCount == 0;
+}
+
+int CompiledStory::choiceCount(int node) const {
+  return static_cast<int>(m_nodes[node].choiceCount);
+}
+
+QString CompiledStory::choiceText(int node, int choice) const {
+  return string(choiceRecord(node, choice).text);
+}
+
+QString CompiledStory::choiceTargetId(int node, int choice) const {
+  return string(choiceRecord(node, choice).target);
+}
+
+int CompiledStory::choiceTargetNode(int node, int choice) const {
+  const quint32 target = choiceRecord(node, choice).targetNode;
+  return target == StoryFormat::InvalidIndex ? -1 : static_cast<int>(target);
+}
+
+QMap<QString, int> CompiledStory::choiceStatChanges(int node,
+                                                    int choice) const {
+  QMap<QString, int> statChanges;
+  const StoryFormat::ChoiceRecord &record = choiceRecord(node, choice);
+  for (quint32 i = 0; i < record.statCount; ++i) {
+    const StoryFormat::StatRecord &stat = m_stats[record.firstStat + i];
+    statChanges[string(stat.name)] = stat.delta;
+  }
+  return statChanges;
+}
+
+QStringList CompiledStory::choiceItemsGained(int node, int choice) const {
+  QStringList itemsGained;
+  const StoryFormat::ChoiceRecord &record = choiceRecord(node, choice);
+  itemsGained.reserve(static_cast<int>(record.itemCount));
+  for (quint32 i = 0; i < record.itemCount; ++i) {
+    itemsGained.append(string(m_items[record.firstItem + i]));
+  }
+  return itemsGained;
+}
+
+int CompiledStory::statDefinitionCount() const {
+  return isOpen() ? static_cast<int>(m_header->statDefinitionCount) : 0;
+}
+
+StatDefinition CompiledStory::statDefinition(int stat) const {
+  const StoryFormat::StatDefinitionRecord &record = m_statDefinitions[stat];
+  StatDefinition definition;
+  definition.id = string(record.id);
+  definition.name = string(record.name);
+  definition.initial = record.initial;
+  definition.minimum = record.minimum;
+  definition.maximum = record.maximum;
+  definition.declared = record.declared != 0;
+  return definition;
+}
+
+int CompiledStory::itemDefinitionCount() const {
+  return isOpen() ? static_cast<int>(m_header->itemDefinitionCount) : 0;
+}
+
+ItemDefinition CompiledStory::itemDefinition(int item) const {
+  const StoryFormat::ItemDefinitionRecord &record = m_itemDefinitions[item];
+  ItemDefinition definition;
+  definition.id = string(record.id);
+  definition.declared = record.declared != 0;
+  definition.effects.reserve(static_cast<int>(record.effectCount));
+  for (quint32 i = 0; i < record.effectCount; ++i) {
+    const StoryFormat::EffectRecord &effect = m_effects[record.firstEffect + i];
+    definition.effects.append(
+        {string(m_statDefinitions[effect.stat].id), effect.delta});
+  }
+  return definition;
+}
+
+int CompiledStory::sourceCount() const {
+  return isOpen() ? static_cast<int>(m_header->sourceCount) : 0;
+}
+
+CompiledSource CompiledStory::source(int index) const {
+  const StoryFormat::SourceRecord &record = m_sources[index];
+  CompiledSource source;
+  source.path = string(record.path);
+  source.size = record.size;
+  source.checksum = record.checksum;
+  source.modified =
+      qint64((quint64(record.modifiedHigh) << 32) | record.modifiedLow);
+  return source;
+}
+
+bool CompiledStory::isBuiltFrom(const QStringList &filePaths) const {
+  if (filePaths.size() != sourceCount()) {
+    return false;
+  }
+
+  for (int i = 0; i < filePaths.size(); ++i) {
+    const CompiledSource recorded = source(i);
+    const QFileInfo info(filePaths[i]);
+    if (!info.isFile() || info.size() != recorded.size ||
+        relativeSourcePath(m_file.fileName(), filePaths[i]) !=
+            recorded.path) {
+      return false;
+    }
+
+    quint32 checksum = 0;
+    if (info.lastModified().toMSecsSinceEpoch() != recorded.modified &&
+        (!fileChecksum(filePaths[i], checksum) ||
+         checksum != recorded.checksum)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CompiledStory::validate(QString &errorMsg) {
+  using namespace StoryFormat;
+
+  const Header &header = *m_header;
+  if (!sectionFits(header.nodesOffset, header.nodeCount, sizeof(NodeRecord),
+                   header.fileSize) ||
+      !sectionFits(header.choicesOffset, header.choiceCount,
+                   sizeof(ChoiceRecord), header.fileSize) ||
+      !sectionFits(header.statsOffset, header.statCount, sizeof(StatRecord),
+                   header.fileSize) ||
+      !sectionFits(header.itemsOffset, header.itemCount, sizeof(StringRef),
+                   header.fileSize) ||
+      !sectionFits(header.statDefinitionsOffset, header.statDefinitionCount,
+                   sizeof(StatDefinitionRecord), header.fileSize) ||
+      !sectionFits(header.itemDefinitionsOffset, header.itemDefinitionCount,
+                   sizeof(ItemDefinitionRecord), header.fileSize) ||
+      !sectionFits(header.effectsOffset, header.effectCount,
+                   sizeof(EffectRecord), header.fileSize) ||
+      !sectionFits(header.sourcesOffset, header.sourceCount,
+                   sizeof(SourceRecord), header.fileSize) ||
+      !sectionFits(header.stringsOffset, header.stringsLength, sizeof(QChar),
+                   header.fileSize)) {
+    errorMsg = "Corrupt section table in compiled story";
+    return false;
+  }
+
+  m_nodes = reinterpret_cast<const NodeRecord *>(m_data + header.nodesOffset);
+  m_choices =
+      reinterpret_cast<const ChoiceRecord *>(m_data + header.choicesOffset);
+  m_stats = reinterpret_cast<const StatRecord *>(m_data + header.statsOffset);
+  m_items = reinterpret_cast<const StringRef *>(m_data + header.itemsOffset);
+  m_statDefinitions = reinterpret_cast<const StatDefinitionRecord *>(
+      m_data + header.statDefinitionsOffset);
+  m_itemDefinitions = reinterpret_cast<const ItemDefinitionRecord *>(
+      m_data + header.itemDefinitionsOffset);
+  m_effects =
+      reinterpret_cast<const EffectRecord *>(m_data + header.effectsOffset);
+  m_sources =
+      reinterpret_cast<const SourceRecord *>(m_data + header.sourcesOffset);
+  m_strings = reinterpret_cast<const QChar *>(m_data + header.stringsOffset);
+
+  if (!isValidString(header.title) || !isValidString(header.startNode)) {
+    errorMsg = "Corrupt story header in compiled story";
+    return false;
+  }
+
+  for (quint32 i = 0; i < header.nodeCount; ++i) {
+    const NodeRecord &node = m_nodes[i];
+    if (!isValidString(node.id) || !isValidString(node.text) ||
+        !rangeFits(node.firstChoice, node.choiceCount, header.choiceCount)) {
+      errorMsg = QString("Corrupt node record %1 in compiled story").arg(i);
+      return false;
+    }
+    if (i > 0) {
+      const NodeRecord &previous = m_nodes[i - 1];
+      if (compareUtf16(m_strings + previous.id.offset,
+                       static_cast<int>(previous.id.length),
+                       m_strings + node.id.offset,
+                       static_cast<int>(node.id.length)) >= 0) {
+        errorMsg = QString("Unsorted node record %1 in compiled story").arg(i);
+        return false;
+      }
+    }
+  }
+
+  for (quint32 i = 0; i < header.choiceCount; ++i) {
+    const ChoiceRecord &choice = m_choices[i];
+    if (!isValidString(choice.text) || !isValidString(choice.target) ||
+        (choice.targetNode != InvalidIndex &&
+         choice.targetNode >= header.nodeCount) ||
+        !rangeFits(choice.firstStat, choice.statCount, header.statCount) ||
+        !rangeFits(choice.firstItem, choice.itemCount, header.itemCount)) {
+      errorMsg = QString("Corrupt choice record %1 in compiled story").arg(i);
+      return false;
+    }
+  }
+
+  for (quint32 i = 0; i < header.statCount; ++i) {
+    if (!isValidString(m_stats[i].name)) {
+      errorMsg = QString("Corrupt stat record %1 in compiled story").arg(i);
+      return false;
+    }
+  }
+
+  for (quint32 i = 0; i < header.itemCount; ++i) {
+    if (!isValidString(m_items[i])) {
+      errorMsg = QString("Corrupt item record %1 in compiled story").arg(i);
+      return false;
+    }
+  }
+
+  for (quint32 i = 0; i < header.statDefinitionCount; ++i) {
+    const StatDefinitionRecord &stat = m_statDefinitions[i];
+    if (!isValidString(stat.id) || !isValidString(stat.name) ||
+        stat.minimum > stat.maximum || stat.initial < stat.minimum ||
+        stat.initial > stat.maximum || stat.declared > 1) {
+      errorMsg =
+          QString("Corrupt stat definition %1 in compiled story").arg(i);
+      return false;
+    }
+  }
+
+  for (quint32 i = 0; i < header.itemDefinitionCount; ++i) {
+    const ItemDefinitionRecord &item = m_itemDefinitions[i];
+    if (!isValidString(item.id) || item.declared > 1 ||
+        !rangeFits(item.firstEffect, item.effectCount, header.effectCount) ||
+        (!item.declared && item.effectCount != 0)) {
+      errorMsg =
+          QString("Corrupt item definition %1 in compiled story").arg(i);
+      return false;
+    }
+  }
+
+  for (quint32 i = 0; i < header.effectCount; ++i) {
+    if (m_effects[i].stat >= header.statDefinitionCount) {
+      errorMsg = QString("Corrupt item effect %1 in compiled story").arg(i);
+      return false;
+    }
+  }
+
+  for (quint32 i = 0; i < header.sourceCount; ++i) {
+    if (!isValidString(m_sources[i].path)) {
+      errorMsg = QString("Corrupt source record %1 in compiled story").arg(i);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool CompiledStory::isValidString(const StoryFormat::StringRef &ref) const {
+  return rangeFits(ref.offset, ref.length, m_header->stringsLength);
+}
+
+QString CompiledStory::string(const StoryFormat::StringRef &ref) const {
+  return QString(m_strings + ref.offset, static_cast<int>(ref.length));
+}
+
+const StoryFormat::ChoiceRecord &CompiledStory::choiceRecord(int node,
+                                                             int choice) const {
+  return m_choices[m_nodes[node].firstChoice + choice];
+}
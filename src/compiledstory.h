@@ -0,0 +1,80 @@
+#ifndef COMPILEDSTORY_H
+#define COMPILEDSTORY_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QFile>
+#include "storyformat.h"
+#include "storygraph.h"
+
+struct CompiledSource {
+    QString path;
+    qint64 size = 0;
+    quint32 checksum = 0;
+    qint64 modified = 0;
+};
+
+class CompiledStory
+{
+public:
+    static bool describeSource(const QString &compiledPath, const QString &sourcePath,
+                               CompiledSource &source, QString &errorMsg);
+
+    CompiledStory();
+    ~CompiledStory();
+
+    bool open(const QString &filePath, QString &errorMsg);
+    void close();
+    bool isOpen() const;
+
+    QString title() const;
+    QString startNodeId() const;
+
+    int nodeCount() const;
+    int findNode(const QString &id) const;
+    QString nodeId(int node) const;
+    QString nodeText(int node) const;
+    bool isEndNode(int node) const;
+
+    int choiceCount(int node) const;
+    QString choiceText(int node, int choice) const;
+    QString choiceTargetId(int node, int choice) const;
+    int choiceTargetNode(int node, int choice) const;
+    QMap<QString, int> choiceStatChanges(int node, int choice) const;
+    QStringList choiceItemsGained(int node, int choice) const;
+
+    int statDefinitionCount() const;
+    StatDefinition statDefinition(int stat) const;
+    int itemDefinitionCount() const;
+    ItemDefinition itemDefinition(int item) const;
+
+    int sourceCount() const;
+    CompiledSource source(int index) const;
+    bool isBuiltFrom(const QStringList &filePaths) const;
+
+private:
+    Q_DISABLE_COPY(CompiledStory)
+
+    friend class StoryGraph;
+
+    bool validate(QString &errorMsg);
+    bool isValidString(const StoryFormat::StringRef &ref) const;
+    QString string(const StoryFormat::StringRef &ref) const;
+    const StoryFormat::ChoiceRecord &choiceRecord(int node, int choice) const;
+
+    QFile m_file;
+    uchar *m_data;
+    const StoryFormat::Header *m_header;
+    const StoryFormat::NodeRecord *m_nodes;
+    const StoryFormat::ChoiceRecord *m_choices;
+    const StoryFormat::StatRecord *m_stats;
+    const StoryFormat::StringRef *m_items;
+    const StoryFormat::StatDefinitionRecord *m_statDefinitions;
+    const StoryFormat::ItemDefinitionRecord *m_itemDefinitions;
+    const StoryFormat::EffectRecord *m_effects;
+    const StoryFormat::SourceRecord *m_sources;
+    const QChar *m_strings;
+};
+
+#endif
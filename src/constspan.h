@@ -0,0 +1,22 @@
+#ifndef CONSTSPAN_H
+#define CONSTSPAN_H
+
+template <typename T>
+class ConstSpan
+{
+public:
+    ConstSpan() = default;
+    ConstSpan(const T *data, int size) : m_data(data), m_size(size) {}
+
+    const T *begin() const { return m_data; }
+    const T *end() const { return m_data + m_size; }
+    const T &operator[](int index) const { return m_data[index]; }
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+private:
+    const T *m_data = nullptr;
+    int m_size = 0;
+};
+
+#endif
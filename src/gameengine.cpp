@@ -1,16 +1,179 @@
 #include "gameengine.h"
 #include "storyloader.h"
 #include <QDebug>
+#include <QFile>
 #include <QTimer>
+#include <limits>
+
+namespace {
+
+const char SessionMagic[] = "RSAV";
+const quint8 SessionVersion = 2;
+
+class SessionWriter {
+public:
+  explicit SessionWriter(QByteArray &data) : m_data(data) {}
+
+  void writeByte(quint8 value) { m_data.append(char(value)); }
+
+  void writeFixed64(quint64 value) {
+    for (int i = 0; i < 8; ++i) {
+      writeByte(quint8(value >> (8 * i)));
+    }
+  }
+
+  void writeVarint(quint64 value) {
+    while (value >= 0x80) {
+      writeByte(quint8(value) | 0x80);
+      value >>= 7;
+    }
+    writeByte(quint8(value));
+  }
+
+  void writeSigned(int value) {
+    writeVarint((quint32(value) << 1) ^ quint32(value >> 31));
+  }
+
+  void writeSymbols(const QVector<int> &symbols) {
+    writeVarint(symbols.size());
+    for (int symbol : symbols) {
+      writeVarint(symbol);
+    }
+  }
+
+  void writeBitset(const Bitset &bitset) {
+    const QVector<quint64> &words = bitset.words();
+    writeVarint(words.size());
+    for (quint64 word : words) {
+      writeVarint(word);
+    }
+  }
+
+private:
+  QByteArray &m_data;
+};
+
+class SessionReader {
+public:
+  SessionReader(const QByteArray &data, int offset)
+      : m_pos(data.constData() + offset),
+        m_end(data.constData() + data.size()) {}
+
+  bool atEnd() const { return m_pos == m_end; }
+
+  bool readByte(quint8 &value) {
+    if (m_pos == m_end) {
+      return false;
+    }
+    value = quint8(*m_pos++);
+    return true;
+  }
+
+  bool readFixed64(quint64 &value) {
+    value = 0;
+    for (int i = 0; i < 8; ++i) {
+      quint8 byte;
+      if (!readByte(byte)) {
+        return false;
+      }
+      value |= quint64(byte) << (8 * i);
+    }
+    return true;
+  }
+
+  bool readVarint(quint64 &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      quint8 byte;
+      if (!readByte(byte)) {
+        return false;
+      }
+      value |= quint64(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readIndex(int limit, int &value) {
+    quint64 raw;
+    if (!readVarint(raw) || raw >= quint64(limit)) {
+      return false;
+    }
+    value = int(raw);
+    return true;
+  }
+
+  bool readCount(int &value) {
+    return readIndex(int(m_end - m_pos) + 1, value);
+  }
+
+  bool readSigned(int &value) {
+    quint64 raw;
+    if (!readVarint(raw) || raw > 0xffffffffull) {
+      return false;
+    }
+    const quint32 zigzag = quint32(raw);
+    value = int((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+    return true;
+  }
+
+  bool readSymbols(int limit, QVector<int> &symbols) {
+    int count;
+    if (!readCount(count)) {
+      return false;
+    }
+    symbols.resize(count);
+    for (int &symbol : symbols) {
+      if (!readIndex(limit, symbol)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool readBitset(int limit, Bitset &bitset) {
+    int count;
+    if (!readIndex((limit + 63) / 64 + 1, count)) {
+      return false;
+    }
+    QVector<quint64> words(count);
+    for (quint64 &word : words) {
+      if (!readVarint(word)) {
+        return false;
+      }
+    }
+    if (count > 0 && (limit & 63) && count == (limit + 63) / 64 &&
+        words.last() >> (limit & 63)) {
+      return false;
+    }
+    bitset = Bitset::fromWords(words);
+    return true;
+  }
+
+private:
+  const char *m_pos;
+  const char *m_end;
+};
+
+} // namespace
 
 GameEngine::GameEngine(QObject *parent)
-    : QObject(parent), m_currentNode(nullptr),
-      m_playTimerUpdate(new QTimer(this)) {
-  connect(m_playTimerUpdate, &QTimer::timeout, this,
-          &GameEngine::updatePlayTime);
+    : QObject(parent), m_currentNode(nullptr), m_storyWatcher(nullptr),
+      m_reloadTimer(new QTimer(this)) {
+  connect(m_reloadTimer, &QTimer::timeout, this,
+          &GameEngine::reloadChangedFiles);
+  m_reloadTimer->setSingleShot(true);
+  m_reloadTimer->setInterval(100);
+  m_loadOptions.threadCount = 0;
+  m_storyFiles = StoryLoader::defaultStoryFiles();
 }
 
-GameEngine::~GameEngine() { clearStory(); }
+GameEngine::~GameEngine() {
+  blockSignals(true);
+  clearStory();
+}
 
 QString GameEngine::currentText() const {
   if (m_currentNode) {
@@ -26,94 +189,393 @@ QString GameEngine::currentNodeId() const {
   return QString();
 }
 
-QString GameEngine::storyTitle() const { return m_storyTitle; }
+QString GameEngine::storyTitle() const {
+  return m_story ? m_story->title() : QString();
+}
 
 QVariantList GameEngine::choices() const {
   QVariantList result;
   if (m_currentNode) {
-    const QList<Choice *> &choices = m_currentNode->choices();
-    for (Choice *choice : choices) {
+    for (int i = 0; i < m_currentNode->choiceCount(); ++i) {
       QVariantMap choiceMap;
-      choiceMap["text"] = choice->text();
+      choiceMap["text"] = m_currentNode->choice(i).text();
       result.append(choiceMap);
     }
   }
   return result;
 }
 
-bool GameEngine::canGoBack() const { return !m_history.isEmpty(); }
+bool GameEngine::canGoBack() const { return !m_undo.isEmpty(); }
 
 bool GameEngine::isGameEnded() const {
   return m_currentNode && m_currentNode->isEndNode();
 }
 
-int GameEngine::health() const { return m_health; }
+int GameEngine::health() const { return statValue(m_healthStat); }
+
+int GameEngine::strength() const { return statValue(m_strengthStat); }
 
-int GameEngine::strength() const { return m_strength; }
+int GameEngine::intelligence() const { return statValue(m_intelligenceStat); }
 
-int GameEngine::intelligence() const { return m_intelligence; }
+int GameEngine::wisdom() const { return statValue(m_wisdomStat); }
 
-int GameEngine::wisdom() const { return m_wisdom; }
+int GameEngine::fortune() const { return statValue(m_fortuneStat); }
+
+int GameEngine::statCount() const { return m_stats.size(); }
+
+QString GameEngine::statId(int stat) const {
+  if (!m_graph || stat < 0 || stat >= m_graph->statCount()) {
+    return QString();
+  }
+  return m_graph->statDefinition(stat).id;
+}
+
+QString GameEngine::statName(int stat) const {
+  if (!m_graph || stat < 0 || stat >= m_graph->statCount()) {
+    return QString();
+  }
+  return m_graph->statDefinition(stat).name;
+}
+
+int GameEngine::statValue(int stat) const { return m_stats.value(stat); }
+
+int GameEngine::stat(const QString &id) const {
+  return m_graph ? statValue(m_graph->symbols().stats.find(id)) : 0;
+}
 
 int GameEngine::choicesMade() const { return m_choicesMade; }
 
-int GameEngine::nodesVisited() const { return m_visitedNodes.size(); }
+int GameEngine::nodesVisited() const { return m_visitedNodes.count(); }
+
+int GameEngine::playTimeSeconds() const {
+  if (!m_playTimer.isValid()) {
+    return m_playTimeBase;
+  }
+  return m_playTimeBase + int(m_playTimer.elapsed() / 1000);
+}
+
+QStringList GameEngine::inventory() const {
+  QStringList names;
+  names.reserve(m_inventory.size());
+  for (int item : m_inventory.items()) {
+    names.append(itemName(item));
+  }
+  return names;
+}
+
+const Inventory &GameEngine::inventoryItems() const { return m_inventory; }
+
+QString GameEngine::itemName(int item) const {
+  return m_graph ? m_graph->symbols().items.name(item) : QString();
+}
+
+int GameEngine::itemCount(const QString &itemId) const {
+  if (!m_graph) {
+    return 0;
+  }
+  return m_inventory.count(m_graph->symbols().items.find(itemId));
+}
 
-int GameEngine::playTimeSeconds() const { return m_playTimeSeconds; }
+bool GameEngine::hasItem(const QString &itemId) const {
+  return itemCount(itemId) > 0;
+}
 
-QStringList GameEngine::inventory() const { return m_inventory; }
+QStringList GameEngine::endingsFound() const {
+  QStringList names;
+  if (!m_graph) {
+    return names;
+  }
 
-QStringList GameEngine::endingsFound() const { return m_endingsFound; }
+  names.reserve(m_endingsFound.count());
+  for (int ending = m_endingsFound.nextSetBit(0); ending >= 0;
+       ending = m_endingsFound.nextSetBit(ending + 1)) {
+    names.append(m_graph->symbols().nodes.name(ending));
+  }
+  return names;
+}
 
 bool GameEngine::isChoicePreviouslySelected(const QString &nodeId,
                                             int choiceIndex) const {
-  QString key = nodeId + ":" + QString::number(choiceIndex);
-  return m_selectedChoices.contains(key);
+  const int node = m_graph ? m_graph->findNode(nodeId) : -1;
+  return m_selectedChoices.test(choiceOrdinal(node, choiceIndex));
+}
+
+bool GameEngine::isChoicePreviouslySelected(int choiceIndex) const {
+  const int node = m_currentNode ? m_currentNode->symbol() : -1;
+  return m_selectedChoices.test(choiceOrdinal(node, choiceIndex));
+}
+
+QVariantMap GameEngine::hintFor(const QString &nodeId) const {
+  QVariantMap result;
+  const int node = m_graph ? m_graph->findNode(nodeId) : -1;
+  const StoryHint hint = m_story ? m_story->hints().hint(node) : StoryHint();
+  if (hint.isValid()) {
+    result["distance"] = hint.distance;
+    result["choice"] = hint.choice;
+    if (hint.choice >= 0) {
+      result["choiceText"] = m_graph->node(node).choice(hint.choice).text();
+    }
+    result["ending"] = m_graph->node(hint.ending).id();
+  }
+  return result;
+}
+
+int GameEngine::undoDepth() const { return m_undo.size(); }
+
+qint64 GameEngine::undoMemoryBytes() const { return m_undoBytes; }
+
+qint64 GameEngine::undoMemoryLimit() const { return m_undoMemoryLimit; }
+
+void GameEngine::setUndoMemoryLimit(qint64 bytes) {
+  m_undoMemoryLimit = bytes;
+  trimUndo();
+}
+
+QByteArray GameEngine::saveState() const {
+  QByteArray data;
+  if (!m_currentNode) {
+    return data;
+  }
+
+  data.reserve(64 + m_inventory.grantCount() * 2 +
+               m_visitedNodes.memoryBytes() + m_selectedChoices.memoryBytes() +
+               m_undo.size() * 8);
+  data.append(SessionMagic, 4);
+  SessionWriter writer(data);
+  writer.writeByte(SessionVersion);
+  writer.writeFixed64(m_story->fingerprint());
+
+  writer.writeVarint(m_currentNode->symbol());
+  writer.writeVarint(m_choicesMade);
+  writer.writeVarint(playTimeSeconds());
+
+  writer.writeVarint(m_stats.size());
+  for (int value : m_stats) {
+    writer.writeSigned(value);
+  }
+  writer.writeSymbols(m_inventory.grants());
+  writer.writeBitset(m_visitedNodes);
+  writer.writeBitset(packChoices(m_selectedChoices));
+  writer.writeBitset(m_endingsFound);
+
+  writer.writeVarint(m_undo.size());
+  const UndoSnapshot *previous = nullptr;
+  for (const UndoSnapshot &snapshot : m_undo) {
+    writer.writeVarint(snapshot.node);
+    writer.writeVarint(snapshot.choicesMade);
+    writer.writeVarint(snapshot.inventorySize);
+    if (previous && previous->stats == snapshot.stats) {
+      writer.writeByte(0);
+    } else {
+      writer.writeByte(1);
+      writer.writeVarint(snapshot.stats.size());
+      for (int value : snapshot.stats) {
+        writer.writeSigned(value);
+      }
+    }
+    previous = &snapshot;
+  }
+
+  return data;
+}
+
+bool GameEngine::loadState(const QByteArray &data, QString &errorMsg) {
+  errorMsg.clear();
+  if (!m_graph || m_startNode < 0) {
+    errorMsg = "No story loaded";
+    return false;
+  }
+
+  if (!data.startsWith(SessionMagic)) {
+    errorMsg = "Not a saved session";
+    return false;
+  }
+
+  SessionReader reader(data, 4);
+  quint8 version = 0;
+  quint64 fingerprint = 0;
+  if (!reader.readByte(version) || version != SessionVersion) {
+    errorMsg = QString("Unsupported session version %1").arg(version);
+    return false;
+  }
+  if (!reader.readFixed64(fingerprint) || fingerprint != m_story->fingerprint()) {
+    errorMsg = "Saved session belongs to a different story";
+    return false;
+  }
+
+  const int nodeCount = m_graph->nodeCount();
+  const int statCount = m_graph->statCount();
+  const int itemCount = m_graph->symbols().items.size();
+  const int choiceCount = m_story->rules().totalTransitions();
+  auto readStats = [&](QVector<int> &stats) {
+    int count;
+    if (!reader.readIndex(statCount + 1, count)) {
+      return false;
+    }
+    stats.resize(count);
+    for (int &value : stats) {
+      if (!reader.readSigned(value)) {
+        return false;
+      }
+    }
+    for (int stat = count; stat < statCount; ++stat) {
+      stats.append(m_graph->statDefinition(stat).initial);
+    }
+    return true;
+  };
+
+  const int maxInt = std::numeric_limits<int>::max();
+  int currentNode;
+  int choicesMade;
+  int playTime;
+  QVector<int> stats;
+  QVector<int> inventory;
+  Bitset visitedNodes;
+  Bitset selectedChoices;
+  Bitset endingsFound;
+  int undoCount;
+  bool ok = reader.readIndex(nodeCount, currentNode) &&
+            reader.readIndex(maxInt, choicesMade) &&
+            reader.readIndex(maxInt, playTime) && readStats(stats) &&
+            reader.readSymbols(itemCount, inventory) &&
+            reader.readBitset(nodeCount, visitedNodes) &&
+            reader.readBitset(choiceCount, selectedChoices) &&
+            reader.readBitset(nodeCount, endingsFound) &&
+            reader.readCount(undoCount);
+
+  QList<UndoSnapshot> undo;
+  qint64 undoBytes = 0;
+  for (int i = 0; ok && i < undoCount; ++i) {
+    UndoSnapshot snapshot;
+    quint8 hasStats = 0;
+    ok = reader.readIndex(nodeCount, snapshot.node) &&
+         reader.readIndex(maxInt, snapshot.choicesMade) &&
+         reader.readIndex(inventory.size() + 1, snapshot.inventorySize) &&
+         reader.readByte(hasStats) && (hasStats || i > 0) &&
+         (!hasStats || readStats(snapshot.stats));
+    if (ok) {
+      if (!hasStats) {
+        snapshot.stats = undo.last().stats;
+      }
+      snapshot.bytes = snapshotBytes(snapshot, i > 0 ? &undo.last() : nullptr);
+      undoBytes += snapshot.bytes;
+      undo.append(snapshot);
+    }
+  }
+
+  if (!ok || !reader.atEnd()) {
+    errorMsg = "Saved session is corrupt";
+    return false;
+  }
+
+  beginTransition();
+  m_currentNode = &m_graph->node(currentNode);
+  m_choicesMade = choicesMade;
+  m_stats = stats;
+  m_inventory.reset(inventory);
+  m_visitedNodes = visitedNodes;
+  m_selectedChoices = unpackChoices(selectedChoices);
+  m_endingsFound = endingsFound;
+  m_undo = undo;
+  m_undoBytes = undoBytes;
+  trimUndo();
+
+  m_playTimeBase = playTime;
+  m_playTimer.start();
+
+  markDirty(TextDirty | ChoicesDirty | CanGoBackDirty | StatsDirty |
+            InventoryDirty | ChoicesMadeDirty | NodesVisitedDirty |
+            PlayTimeDirty | EndingsDirty);
+  commitTransition();
+  return true;
+}
+
+StoryLoadOptions GameEngine::loadOptions() const { return m_loadOptions; }
+
+void GameEngine::setLoadOptions(const StoryLoadOptions &options) {
+  m_loadOptions = options;
+}
+
+QStringList GameEngine::storyFiles() const { return m_storyFiles; }
+
+void GameEngine::setStoryFiles(const QStringList &filePaths) {
+  m_storyFiles = filePaths;
+}
+
+bool GameEngine::isHotReloadEnabled() const { return m_hotReload; }
+
+void GameEngine::setHotReloadEnabled(bool enabled) {
+  m_hotReload = enabled;
+  watchStoryFiles();
 }
 
 void GameEngine::loadStory(const QString &filePath) {
+  loadStoryFiles(m_storyFiles);
+}
+
+QSharedPointer<const Story> GameEngine::shareStory() {
+  m_ownedStory.reset();
+  return m_story;
+}
+
+void GameEngine::setStory(const QSharedPointer<const Story> &story) {
+  beginTransition();
   clearStory();
+  m_loadedFiles = story ? story->files() : QStringList();
+  watchStoryFiles();
+  startStory(story);
+  commitTransition();
+}
 
-  QString errorMsg;
-  QStringList storyFiles;
-  storyFiles << ":/stories/story_part1.json" << ":/stories/story_part2.json";
-  m_storyNodes = StoryLoader::loadFromMultipleJson(storyFiles, errorMsg);
+void GameEngine::loadStoryFiles(const QStringList &filePaths) {
+  beginTransition();
+  clearStory();
+  m_loadedFiles = filePaths;
+  watchStoryFiles();
 
-  if (!errorMsg.isEmpty()) {
+  StoryLoadOptions options = m_loadOptions;
+  options.compiled = options.compiled && !m_hotReload;
+
+  QString errorMsg;
+  QSharedPointer<Story> story = Story::load(filePaths, options, errorMsg);
+  if (!story) {
     qWarning() << "Error loading story:" << errorMsg;
     emit errorOccurred(errorMsg);
+    markDirty(TextDirty | ChoicesDirty | CanGoBackDirty | StatsDirty);
+    commitTransition();
     return;
   }
 
-  m_startNodeId =
-      StoryLoader::getStartNodeId(":/stories/story_part1.json", errorMsg);
-  if (!errorMsg.isEmpty()) {
-    qWarning() << "Error getting start node:" << errorMsg;
-    emit errorOccurred(errorMsg);
+  startStory(story);
+  m_ownedStory = story;
+  commitTransition();
+}
+
+void GameEngine::startStory(const QSharedPointer<const Story> &story) {
+  if (!story) {
+    markDirty(TextDirty | ChoicesDirty | CanGoBackDirty | StatsDirty);
     return;
   }
 
-  m_storyTitle =
-      StoryLoader::getStoryTitle(":/stories/story_part1.json", errorMsg);
-  if (m_storyTitle.isEmpty()) {
-    m_storyTitle = "Text Adventure Game";
-  }
+  m_story = story;
+  m_graph = &story->graph();
+  m_startNode = story->startNode();
+  resolveSymbols();
+  m_currentNode = &m_graph->node(m_startNode);
 
-  if (m_storyNodes.contains(m_startNodeId)) {
-    m_currentNode = m_storyNodes[m_startNodeId];
-    m_history.clear();
+  m_playTimeBase = 0;
+  m_playTimer.start();
 
-    m_playTimeSeconds = 0;
-    m_playTimer.start();
-    m_playTimerUpdate->start(1000);
+  markDirty(StatsDirty | TextDirty | ChoicesDirty | CanGoBackDirty);
+}
 
-    emit currentTextChanged();
-    emit choicesChanged();
-    emit canGoBackChanged();
-  } else {
-    errorMsg = "Start node not found: " + m_startNodeId;
-    emit errorOccurred(errorMsg);
-  }
+void GameEngine::unloadStory() {
+  m_playTimeBase = playTimeSeconds();
+  m_playTimer.invalidate();
+  clearStory();
+
+  markDirty(TextDirty | ChoicesDirty | CanGoBackDirty | StatsDirty |
+            InventoryDirty | EndingsDirty);
 }
 
 void GameEngine::makeChoice(int choiceIndex) {
@@ -121,227 +583,441 @@ void GameEngine::makeChoice(int choiceIndex) {
     return;
   }
 
-  const QList<Choice *> &choices = m_currentNode->choices();
-  if (choiceIndex >= choices.size()) {
+  if (choiceIndex >= m_currentNode->choiceCount()) {
     return;
   }
 
-  m_history.push(m_currentNode->id());
-
-  Choice *choice = choices[choiceIndex];
+  const Choice &choice = m_currentNode->choice(choiceIndex);
+  if (choice.targetNode() < 0) {
+    return;
+  }
 
-  markChoiceAsSelected(m_currentNode->id(), choiceIndex);
+  beginTransition();
+  if (!canGoBack()) {
+    markDirty(CanGoBackDirty);
+  }
+  pushSnapshot();
 
-  StateChange change;
-  change.statChanges = choice->statChanges();
-  change.itemsGained = choice->itemsGained();
-  m_stateHistory.push(change);
+  markChoiceAsSelected(m_currentNode->symbol(), choiceIndex);
 
-  applyStatChanges(choice->statChanges());
-  addItems(choice->itemsGained());
+  applyStatChanges(choice.statDeltas());
+  addItems(choice.itemSymbols());
 
   m_choicesMade++;
-  emit choicesMadeChanged();
-
-  QString targetNodeId = choice->targetNodeId();
-
-  if (m_storyNodes.contains(targetNodeId)) {
-    StoryNode *nextNode = m_storyNodes[targetNodeId];
-    updateCurrentNode(nextNode);
-  } else {
-    qWarning() << "Target node not found:" << targetNodeId;
-    emit errorOccurred("Invalid choice: target node not found");
-  }
-}
-
-void GameEngine::goBack() {
-  if (!m_history.isEmpty() && !m_stateHistory.isEmpty()) {
-    StateChange lastChange = m_stateHistory.pop();
-
-    for (auto it = lastChange.statChanges.constBegin();
-         it != lastChange.statChanges.constEnd(); ++it) {
-      const QString &statName = it.key();
-      int change = it.value();
-
-      if (statName == "health") {
-        m_health = qBound(0, m_health - change, 100);
-        emit healthChanged();
-      } else if (statName == "strength") {
-        m_strength -= change;
-        emit strengthChanged();
-      } else if (statName == "intelligence") {
-        m_intelligence -= change;
-        emit intelligenceChanged();
-      } else if (statName == "wisdom") {
-        m_wisdom -= change;
-        emit wisdomChanged();
-      }
-    }
+  markDirty(ChoicesMadeDirty);
 
-    for (const QString &item : lastChange.itemsGained) {
-      m_inventory.removeAll(item);
-    }
-    emit inventoryChanged();
+  updateCurrentNode(&m_graph->node(choice.targetNode()));
+  commitTransition();
+}
 
-    m_choicesMade--;
-    emit choicesMadeChanged();
+void GameEngine::goBack() { rewind(1); }
 
-    QString previousNodeId = m_history.pop();
-    if (m_storyNodes.contains(previousNodeId)) {
-      StoryNode *previousNode = m_storyNodes[previousNodeId];
-      updateCurrentNode(previousNode);
-    }
+void GameEngine::rewind(int steps) {
+  if (steps <= 0 || m_undo.isEmpty()) {
+    return;
+  }
+
+  beginTransition();
+  const int index = m_undo.size() - qMin(steps, m_undo.size());
+  const UndoSnapshot snapshot = m_undo.at(index);
+  while (m_undo.size() > index) {
+    m_undoBytes -= m_undo.last().bytes;
+    m_undo.removeLast();
   }
+
+  m_stats = snapshot.stats;
+  for (int stat = m_stats.size(); stat < m_graph->statCount(); ++stat) {
+    m_stats.append(m_graph->statDefinition(stat).initial);
+  }
+  m_inventory.truncate(snapshot.inventorySize);
+  m_choicesMade = snapshot.choicesMade;
+  markDirty(StatsDirty | InventoryDirty | ChoicesMadeDirty);
+
+  if (m_undo.isEmpty()) {
+    markDirty(CanGoBackDirty);
+  }
+  updateCurrentNode(&m_graph->node(snapshot.node));
+  commitTransition();
 }
 
 void GameEngine::restart() {
-  if (!m_startNodeId.isEmpty() && m_storyNodes.contains(m_startNodeId)) {
-    m_currentNode = m_storyNodes[m_startNodeId];
-    m_history.clear();
-    m_stateHistory.clear();
-
-    m_health = 100;
-    m_strength = 10;
-    m_intelligence = 10;
-    m_wisdom = 10;
+  if (m_startNode >= 0) {
+    m_currentNode = &m_graph->node(m_startNode);
+    clearUndo();
+
+    resetStats();
     m_choicesMade = 0;
     m_visitedNodes.clear();
     m_inventory.clear();
-    m_playTimeSeconds = 0;
-
-    m_playTimer.restart();
+    m_playTimeBase = 0;
+    m_playTimer.start();
 
-    emit healthChanged();
-    emit strengthChanged();
-    emit intelligenceChanged();
-    emit wisdomChanged();
-    emit choicesMadeChanged();
-    emit nodesVisitedChanged();
-    emit inventoryChanged();
-    emit playTimeChanged();
-    emit currentTextChanged();
-    emit choicesChanged();
-    emit canGoBackChanged();
+    markDirty(StatsDirty | ChoicesMadeDirty | NodesVisitedDirty |
+              InventoryDirty | PlayTimeDirty | TextDirty | ChoicesDirty |
+              CanGoBackDirty);
   }
 }
 
-void GameEngine::updateCurrentNode(StoryNode *node) {
+void GameEngine::updateCurrentNode(const StoryNode *node) {
   if (node != m_currentNode) {
     m_currentNode = node;
 
-    if (!m_visitedNodes.contains(m_currentNode->id())) {
-      m_visitedNodes.insert(m_currentNode->id());
-      emit nodesVisitedChanged();
+    if (m_visitedNodes.set(m_currentNode->symbol())) {
+      markDirty(NodesVisitedDirty);
     }
 
     if (m_currentNode->isEndNode()) {
-      recordEnding(m_currentNode->id());
+      recordEnding(m_currentNode->symbol());
     }
 
-    emit currentTextChanged();
-    emit choicesChanged();
+    markDirty(TextDirty | ChoicesDirty);
+
+    m_endingReached = m_currentNode->isEndNode();
+  }
+}
+
+void GameEngine::clearStory() {
+  m_currentNode = nullptr;
+  m_startNode = -1;
+  clearUndo();
+  m_visitedNodes.clear();
+  m_selectedChoices.clear();
+  m_endingsFound.clear();
+  m_inventory.clear();
+  m_choicesMade = 0;
+
+  m_stats.clear();
+  m_graph = nullptr;
+  m_ownedStory.reset();
+  m_story.reset();
+
+  markDirty(NodesVisitedDirty | EndingsDirty | ChoicesMadeDirty);
+}
+
+void GameEngine::resolveSymbols() {
+  const StorySymbols &symbols = m_graph->symbols();
+  m_healthStat = symbols.stats.find("health");
+  m_strengthStat = symbols.stats.find("strength");
+  m_intelligenceStat = symbols.stats.find("intelligence");
+  m_wisdomStat = symbols.stats.find("wisdom");
+  m_fortuneStat = symbols.stats.find("fortune");
 
-    bool oldCanGoBack = m_history.isEmpty();
-    bool newCanGoBack = !m_history.isEmpty();
-    if (oldCanGoBack != newCanGoBack) {
-      emit canGoBackChanged();
+  for (int stat = m_stats.size(); stat < m_graph->statCount(); ++stat) {
+    m_stats.append(m_graph->statDefinition(stat).initial);
+  }
+}
+
+void GameEngine::resetStats() {
+  for (int stat = 0; stat < m_stats.size(); ++stat) {
+    m_stats[stat] = m_graph->statDefinition(stat).initial;
+  }
+}
+
+void GameEngine::applyStatChanges(ConstSpan<StatDelta> changes) {
+  if (changes.isEmpty()) {
+    return;
+  }
+
+  for (const StatDelta &statDelta : changes) {
+    adjustStat(statDelta.stat, statDelta.delta);
+  }
+  markDirty(StatsDirty);
+}
+
+void GameEngine::adjustStat(int stat, int delta) {
+  if (stat < 0) {
+    return;
+  }
+
+  m_stats[stat] = m_graph->adjustedStat(stat, m_stats[stat], delta);
+}
+
+void GameEngine::addItems(ConstSpan<int> items) {
+  if (!items.isEmpty()) {
+    bool effectApplied = false;
+    for (int item : items) {
+      m_inventory.grant(item);
+      for (const StatDelta &effect : m_story->itemEffects(item)) {
+        adjustStat(effect.stat, effect.delta);
+        effectApplied = true;
+      }
     }
 
-    if (m_currentNode->isEndNode()) {
-      emit gameEnded(m_currentNode->text());
+    if (effectApplied) {
+      markDirty(StatsDirty);
     }
+    markDirty(InventoryDirty);
   }
 }
 
-void GameEngine::clearStory() {
-  m_currentNode = nullptr;
-  m_startNodeId.clear();
-  m_history.clear();
-  m_stateHistory.clear();
+void GameEngine::pushSnapshot() {
+  UndoSnapshot snapshot;
+  snapshot.node = m_currentNode->symbol();
+  snapshot.choicesMade = m_choicesMade;
+  snapshot.stats = m_stats;
+  snapshot.inventorySize = m_inventory.grantCount();
+  snapshot.bytes =
+      snapshotBytes(snapshot, m_undo.isEmpty() ? nullptr : &m_undo.last());
+
+  m_undo.append(snapshot);
+  m_undoBytes += snapshot.bytes;
+  trimUndo();
+}
 
-  for (StoryNode *node : m_storyNodes) {
-    delete node;
+void GameEngine::trimUndo() {
+  while (m_undoMemoryLimit > 0 && m_undoBytes > m_undoMemoryLimit &&
+         m_undo.size() > 1) {
+    const UndoSnapshot dropped = m_undo.takeFirst();
+    UndoSnapshot &next = m_undo.first();
+    const qint64 bytes = snapshotBytes(next, nullptr);
+    m_undoBytes += bytes - next.bytes - dropped.bytes;
+    next.bytes = bytes;
   }
-  m_storyNodes.clear();
 }
 
-void GameEngine::applyStatChanges(const QMap<QString, int> &changes) {
-  for (auto it = changes.constBegin(); it != changes.constEnd(); ++it) {
-    const QString &statName = it.key();
-    int change = it.value();
+void GameEngine::clearUndo() {
+  m_undo.clear();
+  m_undoBytes = 0;
+}
+
+qint64 GameEngine::snapshotBytes(const UndoSnapshot &snapshot,
+                                 const UndoSnapshot *previous) {
+  qint64 bytes = sizeof(UndoSnapshot);
+  if (!previous || snapshot.stats.constData() != previous->stats.constData()) {
+    bytes += snapshot.stats.capacity() * qint64(sizeof(int));
+  }
+  return bytes;
+}
 
-    if (statName == "health") {
-      m_health = qBound(0, m_health + change, 100);
-      emit healthChanged();
-    } else if (statName == "strength") {
-      m_strength += change;
-      emit strengthChanged();
-    } else if (statName == "intelligence") {
-      m_intelligence += change;
-      emit intelligenceChanged();
-    } else if (statName == "wisdom") {
-      m_wisdom += change;
-      emit wisdomChanged();
+void GameEngine::recordEnding(int endingNode) {
+  if (m_endingsFound.set(endingNode)) {
+    markDirty(EndingsDirty);
+  }
+}
+
+void GameEngine::onStoryFileChanged(const QString &filePath) {
+  if (!m_pendingReloads.contains(filePath)) {
+    m_pendingReloads.append(filePath);
+  }
+  m_reloadTimer->start();
+}
+
+void GameEngine::reloadChangedFiles() {
+  const QStringList filePaths = m_pendingReloads;
+  m_pendingReloads.clear();
+
+  for (const QString &filePath : filePaths) {
+    if (!QFile::exists(filePath)) {
+      continue;
     }
+    if (!m_storyWatcher->files().contains(filePath)) {
+      m_storyWatcher->addPath(filePath);
+    }
+    reloadStoryFile(filePath);
   }
 }
 
-void GameEngine::addItems(const QStringList &items) {
-  if (!items.isEmpty()) {
-    m_inventory.append(items);
+void GameEngine::reloadStoryFile(const QString &filePath) {
+  const int file = m_loadedFiles.indexOf(filePath);
+  if (file < 0) {
+    return;
+  }
 
-    for (const QString &item : items) {
-      if (item.contains("Crystal", Qt::CaseInsensitive)) {
-        m_intelligence += 2;
-        emit intelligenceChanged();
-      }
-      if (item.contains("Sword", Qt::CaseInsensitive)) {
-        m_strength += 2;
-        emit strengthChanged();
-      }
-      if (item.contains("Jade", Qt::CaseInsensitive)) {
-        m_wisdom += 2;
-        emit wisdomChanged();
-      }
-      if (item.contains("Celestial", Qt::CaseInsensitive)) {
-        m_strength += 1;
-        m_intelligence += 1;
-        m_wisdom += 1;
-        emit strengthChanged();
-        emit intelligenceChanged();
-        emit wisdomChanged();
-      }
-      if (item.contains("Token", Qt::CaseInsensitive)) {
-        m_health += 5;
-        emit healthChanged();
-      }
-      if (item.contains("Blessing", Qt::CaseInsensitive)) {
-        m_wisdom += 3;
-        emit wisdomChanged();
+  if (m_story && m_story->isCompiled()) {
+    qWarning() << "Compiled story cannot be hot-reloaded from" << filePath;
+    return;
+  }
+
+  if (!m_story) {
+    loadStoryFiles(m_loadedFiles);
+    return;
+  }
+
+  beginTransition();
+  const int currentNode = m_currentNode->symbol();
+  if (!m_ownedStory) {
+    m_ownedStory = m_story->clone();
+    m_story = m_ownedStory;
+    m_graph = &m_ownedStory->graph();
+    m_currentNode = &m_graph->node(currentNode);
+  }
+
+  QVector<QPair<int, int>> selectedChoices;
+  for (int node : m_graph->fileNodes(file)) {
+    for (int i = 0; i < m_story->rules().transitionCount(node); ++i) {
+      if (m_selectedChoices.reset(choiceOrdinal(node, i))) {
+        selectedChoices.append(qMakePair(node, i));
       }
-      if (item.contains("Manual", Qt::CaseInsensitive)) {
-        m_intelligence += 3;
-        emit intelligenceChanged();
+    }
+  }
+
+  StoryReload reload = m_ownedStory->reloadFile(file, filePath, m_loadOptions);
+  m_currentNode = &m_graph->node(currentNode);
+  resolveSymbols();
+
+  if (!reload.movedTransitions.isEmpty()) {
+    Bitset moved;
+    for (int ordinal = m_selectedChoices.nextSetBit(0); ordinal >= 0;
+         ordinal = m_selectedChoices.nextSetBit(ordinal + 1)) {
+      const int target = reload.movedTransitions.value(ordinal, -1);
+      if (target >= 0) {
+        moved.set(target);
       }
     }
+    m_selectedChoices = moved;
+  }
 
-    emit inventoryChanged();
+  for (const QPair<int, int> &choice : qAsConst(selectedChoices)) {
+    if (choice.second < m_graph->node(choice.first).choiceCount()) {
+      markChoiceAsSelected(choice.first, choice.second);
+    }
   }
+  markDirty(StatsDirty);
+
+  if (reload.hasErrors()) {
+    emit errorOccurred(reload.errors.join("; "));
+  }
+
+  markDirty(TextDirty | ChoicesDirty);
+  commitTransition();
+  emit storyReloaded(filePath);
 }
 
-void GameEngine::recordEnding(const QString &endingId) {
-  if (!m_endingsFound.contains(endingId)) {
-    m_endingsFound.append(endingId);
+void GameEngine::watchStoryFiles() {
+  if (m_storyWatcher) {
+    const QStringList watched = m_storyWatcher->files();
+    if (!watched.isEmpty()) {
+      m_storyWatcher->removePaths(watched);
+    }
+  }
+
+  if (!m_hotReload) {
+    return;
+  }
+
+  if (!m_storyWatcher) {
+    m_storyWatcher = new QFileSystemWatcher(this);
+    connect(m_storyWatcher, &QFileSystemWatcher::fileChanged, this,
+            &GameEngine::onStoryFileChanged);
+  }
+
+  for (const QString &filePath : qAsConst(m_loadedFiles)) {
+    if (!filePath.startsWith(':')) {
+      m_storyWatcher->addPath(filePath);
+    }
+  }
+}
+
+void GameEngine::beginTransition() { ++m_transitionDepth; }
+
+void GameEngine::commitTransition() {
+  if (--m_transitionDepth == 0) {
+    flushChanges();
+  }
+}
+
+void GameEngine::markDirty(DirtyMask changes) {
+  m_dirty |= changes;
+  if (m_transitionDepth == 0) {
+    flushChanges();
+  }
+}
+
+void GameEngine::flushChanges() {
+  const QVector<InventoryChange> inventoryChanges = m_inventory.takeChanges();
+  DirtyMask changes = m_dirty;
+  if (!inventoryChanges.isEmpty()) {
+    changes |= InventoryDirty;
+  }
+  const bool endingReached = m_endingReached;
+  m_dirty = DirtyMask();
+  m_endingReached = false;
+
+  if (changes & TextDirty) {
+    emit currentTextChanged();
+  }
+  if (changes & ChoicesDirty) {
+    emit choicesChanged();
+  }
+  if (changes & CanGoBackDirty) {
+    emit canGoBackChanged();
+  }
+  if (changes & StatsDirty) {
+    emit statsChanged();
+  }
+  if (changes & InventoryDirty) {
+    emit inventoryChanged();
+    if (!inventoryChanges.isEmpty()) {
+      emit inventoryItemsChanged(inventoryChanges);
+    }
+  }
+  if (changes & ChoicesMadeDirty) {
+    emit choicesMadeChanged();
+  }
+  if (changes & NodesVisitedDirty) {
+    emit nodesVisitedChanged();
+  }
+  if (changes & PlayTimeDirty) {
+    emit playTimeChanged();
+  }
+  if (changes & EndingsDirty) {
     emit endingsFoundChanged();
   }
+
+  if (changes) {
+    emit stateChanged(changes);
+  }
+  if (endingReached && m_currentNode) {
+    emit gameEnded(m_currentNode->text());
+  }
+}
+
+void GameEngine::markChoiceAsSelected(int node, int choiceIndex) {
+  m_selectedChoices.set(choiceOrdinal(node, choiceIndex));
 }
 
-void GameEngine::updatePlayTime() {
-  m_playTimeSeconds = m_playTimer.elapsed() / 1000;
-  emit playTimeChanged();
+int GameEngine::choiceOrdinal(int node, int choiceIndex) const {
+  if (!m_story || node < 0 || node >= m_graph->nodeCount() || choiceIndex < 0 ||
+      choiceIndex >= m_story->rules().transitionCount(node)) {
+    return -1;
+  }
+  return m_story->rules().firstTransition(node) + choiceIndex;
 }
 
-void GameEngine::markChoiceAsSelected(const QString &nodeId, int choiceIndex) {
-  QString key = nodeId + ":" + QString::number(choiceIndex);
-  m_selectedChoices.insert(key);
+Bitset GameEngine::packChoices(const Bitset &choices) const {
+  const StoryRules &rules = m_story->rules();
+  if (rules.isPacked()) {
+    return choices;
+  }
+
+  Bitset packed;
+  int ordinal = 0;
+  for (int node = 0; node < m_graph->nodeCount(); ++node) {
+    const int first = rules.firstTransition(node);
+    for (int i = 0; i < rules.transitionCount(node); ++i, ++ordinal) {
+      if (choices.test(first + i)) {
+        packed.set(ordinal);
+      }
+    }
+  }
+  return packed;
+}
+
+Bitset GameEngine::unpackChoices(const Bitset &choices) const {
+  const StoryRules &rules = m_story->rules();
+  if (rules.isPacked()) {
+    return choices;
+  }
+
+  Bitset unpacked;
+  int ordinal = 0;
+  for (int node = 0; node < m_graph->nodeCount(); ++node) {
+    const int first = rules.firstTransition(node);
+    for (int i = 0; i < rules.transitionCount(node); ++i, ++ordinal) {
+      if (choices.test(ordinal)) {
+        unpacked.set(first + i);
+      }
+    }
+  }
+  return unpacked;
 }
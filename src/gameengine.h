@@ -5,17 +5,24 @@
 #include <QString>
 #include <QVariant>
 #include <QVariantList>
-#include <QStack>
-#include <QMap>
-#include <QSet>
+#include <QList>
+#include <QByteArray>
+#include <QVector>
 #include <QElapsedTimer>
 #include <QTimer>
+#include <QFileSystemWatcher>
 #include <QPair>
-#include "storynode.h"
-
-struct StateChange {
-    QMap<QString, int> statChanges;
-    QStringList itemsGained;
+#include <QSharedPointer>
+#include "bitset.h"
+#include "inventory.h"
+#include "story.h"
+
+struct UndoSnapshot {
+    int node = -1;
+    int choicesMade = 0;
+    int inventorySize = 0;
+    QVector<int> stats;
+    qint64 bytes = 0;
 };
 
 class GameEngine : public QObject
@@ -26,10 +33,11 @@ class GameEngine : public QObject
     Q_PROPERTY(bool canGoBack READ canGoBack NOTIFY canGoBackChanged)
     Q_PROPERTY(bool isGameEnded READ isGameEnded NOTIFY gameEnded)
 
-    Q_PROPERTY(int health READ health NOTIFY healthChanged)
-    Q_PROPERTY(int strength READ strength NOTIFY strengthChanged)
-    Q_PROPERTY(int intelligence READ intelligence NOTIFY intelligenceChanged)
-    Q_PROPERTY(int wisdom READ wisdom NOTIFY wisdomChanged)
+    Q_PROPERTY(int health READ health NOTIFY statsChanged)
+    Q_PROPERTY(int strength READ strength NOTIFY statsChanged)
+    Q_PROPERTY(int intelligence READ intelligence NOTIFY statsChanged)
+    Q_PROPERTY(int wisdom READ wisdom NOTIFY statsChanged)
+    Q_PROPERTY(int fortune READ fortune NOTIFY statsChanged)
 
     Q_PROPERTY(int choicesMade READ choicesMade NOTIFY choicesMadeChanged)
     Q_PROPERTY(int nodesVisited READ nodesVisited NOTIFY nodesVisitedChanged)
@@ -40,6 +48,22 @@ class GameEngine : public QObject
     Q_PROPERTY(QStringList endingsFound READ endingsFound NOTIFY endingsFoundChanged)
 
 public:
+    enum DirtyFlag {
+        TextDirty = 0x001,
+        ChoicesDirty = 0x002,
+        CanGoBackDirty = 0x004,
+        StatsDirty = 0x008,
+        InventoryDirty = 0x010,
+        ChoicesMadeDirty = 0x020,
+        NodesVisitedDirty = 0x040,
+        PlayTimeDirty = 0x080,
+        EndingsDirty = 0x100
+    };
+    Q_DECLARE_FLAGS(DirtyMask, DirtyFlag)
+    Q_FLAG(DirtyMask)
+
+    static const qint64 DefaultUndoMemoryLimit = 4 * 1024 * 1024;
+
     explicit GameEngine(QObject *parent = nullptr);
     ~GameEngine();
 
@@ -54,20 +78,55 @@ public:
     int strength() const;
     int intelligence() const;
     int wisdom() const;
+    int fortune() const;
+
+    int statCount() const;
+    QString statId(int stat) const;
+    QString statName(int stat) const;
+    int statValue(int stat) const;
+    int stat(const QString &id) const;
 
     int choicesMade() const;
     int nodesVisited() const;
     int playTimeSeconds() const;
 
     QStringList inventory() const;
+    const Inventory &inventoryItems() const;
+    QString itemName(int item) const;
+    Q_INVOKABLE int itemCount(const QString &itemId) const;
+    Q_INVOKABLE bool hasItem(const QString &itemId) const;
 
     QStringList endingsFound() const;
 
     bool isChoicePreviouslySelected(const QString &nodeId, int choiceIndex) const;
+    bool isChoicePreviouslySelected(int choiceIndex) const;
+    Q_INVOKABLE QVariantMap hintFor(const QString &nodeId) const;
+
+    int undoDepth() const;
+    qint64 undoMemoryBytes() const;
+    qint64 undoMemoryLimit() const;
+    void setUndoMemoryLimit(qint64 bytes);
+
+    QByteArray saveState() const;
+    bool loadState(const QByteArray &data, QString &errorMsg);
+
+    QSharedPointer<const Story> shareStory();
+    void setStory(const QSharedPointer<const Story> &story);
+
+    StoryLoadOptions loadOptions() const;
+    void setLoadOptions(const StoryLoadOptions &options);
+
+    QStringList storyFiles() const;
+    void setStoryFiles(const QStringList &filePaths);
+    bool isHotReloadEnabled() const;
+    void setHotReloadEnabled(bool enabled);
 
     Q_INVOKABLE void loadStory(const QString &filePath);
+    Q_INVOKABLE void loadStoryFiles(const QStringList &filePaths);
+    Q_INVOKABLE void unloadStory();
     Q_INVOKABLE void makeChoice(int choiceIndex);
     Q_INVOKABLE void goBack();
+    Q_INVOKABLE void rewind(int steps);
     Q_INVOKABLE void restart();
 
 signals:
@@ -78,54 +137,91 @@ signals:
     void gameOver(const QString &reason);
     void errorOccurred(const QString &error);
 
-    void healthChanged();
-    void strengthChanged();
-    void intelligenceChanged();
-    void wisdomChanged();
+    void statsChanged();
 
     void choicesMadeChanged();
     void nodesVisitedChanged();
     void playTimeChanged();
 
     void inventoryChanged();
+    void inventoryItemsChanged(const QVector<InventoryChange> &changes);
 
     void endingsFoundChanged();
 
+    void storyReloaded(const QString &filePath);
+
+    void stateChanged(GameEngine::DirtyMask changes);
+
 private slots:
-    void updatePlayTime();
+    void onStoryFileChanged(const QString &filePath);
+    void reloadChangedFiles();
 
 private:
-    void updateCurrentNode(StoryNode *node);
+    void beginTransition();
+    void commitTransition();
+    void markDirty(DirtyMask changes);
+    void flushChanges();
+    void updateCurrentNode(const StoryNode *node);
+    void reloadStoryFile(const QString &filePath);
+    void watchStoryFiles();
     void clearStory();
-    void applyStatChanges(const QMap<QString, int> &changes);
-    void addItems(const QStringList &items);
-    void recordEnding(const QString &endingId);
-    void markChoiceAsSelected(const QString &nodeId, int choiceIndex);
-
-    QMap<QString, StoryNode*> m_storyNodes;
-    StoryNode* m_currentNode;
-    QString m_startNodeId;
-    QString m_storyTitle;
-    QStack<QString> m_history;
-    QStack<StateChange> m_stateHistory;
-
-    int m_health = 100;
-    int m_strength = 10;
-    int m_intelligence = 10;
-    int m_wisdom = 10;
+    void startStory(const QSharedPointer<const Story> &story);
+    void resolveSymbols();
+    void resetStats();
+    void applyStatChanges(ConstSpan<StatDelta> changes);
+    void adjustStat(int stat, int delta);
+    void addItems(ConstSpan<int> items);
+    void pushSnapshot();
+    void trimUndo();
+    void clearUndo();
+    static qint64 snapshotBytes(const UndoSnapshot &snapshot, const UndoSnapshot *previous);
+    void recordEnding(int endingNode);
+    void markChoiceAsSelected(int node, int choiceIndex);
+    int choiceOrdinal(int node, int choiceIndex) const;
+    Bitset packChoices(const Bitset &choices) const;
+    Bitset unpackChoices(const Bitset &choices) const;
+
+    StoryLoadOptions m_loadOptions;
+    QStringList m_storyFiles;
+    QStringList m_loadedFiles;
+    bool m_hotReload = false;
+    QSharedPointer<const Story> m_story;
+    QSharedPointer<Story> m_ownedStory;
+    const StoryGraph *m_graph = nullptr;
+    const StoryNode* m_currentNode;
+    int m_startNode = -1;
+    QList<UndoSnapshot> m_undo;
+    qint64 m_undoBytes = 0;
+    qint64 m_undoMemoryLimit = DefaultUndoMemoryLimit;
+
+    int m_healthStat = -1;
+    int m_strengthStat = -1;
+    int m_intelligenceStat = -1;
+    int m_wisdomStat = -1;
+    int m_fortuneStat = -1;
+
+    QVector<int> m_stats;
 
     int m_choicesMade = 0;
-    QSet<QString> m_visitedNodes;
-    int m_playTimeSeconds = 0;
+    Bitset m_visitedNodes;
+    int m_playTimeBase = 0;
     QElapsedTimer m_playTimer;
 
-    QStringList m_inventory;
+    Inventory m_inventory;
+
+    Bitset m_endingsFound;
 
-    QStringList m_endingsFound;
+    Bitset m_selectedChoices;
 
-    QSet<QString> m_selectedChoices;
+    int m_transitionDepth = 0;
+    DirtyMask m_dirty;
+    bool m_endingReached = false;
 
-    QTimer *m_playTimerUpdate;
+    QFileSystemWatcher *m_storyWatcher;
+    QTimer *m_reloadTimer;
+    QStringList m_pendingReloads;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(GameEngine::DirtyMask)
+
 #endif
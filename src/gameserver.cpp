@@ -0,0 +1,151 @@
+#include "gameserver.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTcpSocket>
+
+ServerWorker::ServerWorker(const QSharedPointer<const Story> &story,
+                           int threadCount, QObject *parent)
+    : QObject(parent), m_story(story), m_threadCount(threadCount) {}
+
+void ServerWorker::addConnection(qintptr socketDescriptor) {
+  QTcpSocket *socket = new QTcpSocket(this);
+  if (!socket->setSocketDescriptor(socketDescriptor)) {
+    qWarning() << "Could not accept connection:" << socket->errorString();
+    delete socket;
+    return;
+  }
+  socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+  socket->setReadBufferSize(MaxLineBytes);
+
+  m_sessions[socket].start(*m_story);
+
+  connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+    while (socket->canReadLine()) {
+      handleLine(socket, socket->readLine());
+    }
+    if (socket->bytesAvailable() >= MaxLineBytes) {
+      qWarning() << "Dropping connection: request line exceeds"
+                 << MaxLineBytes << "bytes";
+      socket->abort();
+    }
+  });
+  connect(socket, &QTcpSocket::disconnected, socket, [this, socket]() {
+    m_sessions.remove(socket);
+    socket->deleteLater();
+  });
+}
+
+void ServerWorker::handleLine(QTcpSocket *socket, const QByteArray &line) {
+  if (line.trimmed().isEmpty()) {
+    return;
+  }
+
+  QJsonParseError parseError;
+  const QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+  QJsonObject response;
+  if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+    response["ok"] = false;
+    response["error"] = "Invalid request";
+  } else {
+    response = handleRequest(m_sessions[socket], document.object());
+  }
+
+  socket->write(QJsonDocument(response).toJson(QJsonDocument::Compact));
+  socket->write("\n");
+}
+
+QJsonObject ServerWorker::handleRequest(SessionState &session,
+                                        const QJsonObject &request) {
+  const QString command = request.value("cmd").toString();
+  QString error;
+
+  if (command == "loadStory" || command == "restart") {
+    session.start(*m_story);
+  } else if (command == "makeChoice") {
+    if (!session.makeChoice(*m_story, request.value("choice").toInt(-1))) {
+      error = "Invalid choice";
+    }
+  } else if (command == "goBack") {
+    if (!session.rewind(*m_story, 1)) {
+      error = "Nothing to go back to";
+    }
+  } else if (command == "info") {
+    QJsonObject info;
+    info["ok"] = true;
+    info["title"] = m_story->title();
+    info["threads"] = m_threadCount;
+    return info;
+  } else if (command != "state") {
+    error = QString("Unknown command '%1'").arg(command);
+  }
+
+  QJsonObject response = sessionJson(session);
+  response["ok"] = error.isEmpty();
+  if (!error.isEmpty()) {
+    response["error"] = error;
+  }
+  return response;
+}
+
+QJsonObject ServerWorker::sessionJson(const SessionState &session) const {
+  const StoryGraph &graph = m_story->graph();
+  const StoryNode &node = graph.node(session.node);
+
+  QJsonArray choices;
+  for (int i = 0; i < node.choiceCount(); ++i) {
+    choices.append(node.choice(i).text());
+  }
+
+  QJsonObject stats;
+  for (int stat = 0; stat < session.stats.size(); ++stat) {
+    stats[graph.statDefinition(stat).id] = session.stats[stat];
+  }
+
+  QJsonObject state;
+  state["node"] = node.id();
+  state["text"] = node.text();
+  state["choices"] = choices;
+  state["stats"] = stats;
+  state["canGoBack"] = !session.history.isEmpty();
+  state["ended"] = node.isEndNode();
+  return state;
+}
+
+GameServer::GameServer(const QSharedPointer<const Story> &story,
+                       int threadCount, QObject *parent)
+    : QTcpServer(parent) {
+  threadCount = qMax(1, threadCount);
+  for (int i = 0; i < threadCount; ++i) {
+    QThread *thread = new QThread(this);
+    ServerWorker *worker = new ServerWorker(story, threadCount);
+    worker->moveToThread(thread);
+    connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread->start();
+
+    m_threads.append(thread);
+    m_workers.append(worker);
+  }
+}
+
+GameServer::~GameServer() {
+  close();
+  for (QThread *thread : qAsConst(m_threads)) {
+    thread->quit();
+  }
+  for (QThread *thread : qAsConst(m_threads)) {
+    thread->wait();
+  }
+}
+
+int GameServer::threadCount() const { return m_threads.size(); }
+
+void GameServer::incomingConnection(qintptr socketDescriptor) {
+  ServerWorker *worker = m_workers[m_nextWorker];
+  m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+  QMetaObject::invokeMethod(
+      worker, [worker, socketDescriptor]() {
+        worker->addConnection(socketDescriptor);
+      },
+      Qt::QueuedConnection);
+}
@@ -0,0 +1,58 @@
+#ifndef GAMESERVER_H
+#define GAMESERVER_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTcpServer>
+#include <QThread>
+#include <QVector>
+#include "sessionstate.h"
+#include "story.h"
+
+class QTcpSocket;
+
+class ServerWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int MaxLineBytes = 64 * 1024;
+
+    ServerWorker(const QSharedPointer<const Story> &story, int threadCount,
+                 QObject *parent = nullptr);
+
+    void addConnection(qintptr socketDescriptor);
+
+private:
+    void handleLine(QTcpSocket *socket, const QByteArray &line);
+    QJsonObject handleRequest(SessionState &session, const QJsonObject &request);
+    QJsonObject sessionJson(const SessionState &session) const;
+
+    QSharedPointer<const Story> m_story;
+    int m_threadCount;
+    QHash<QTcpSocket *, SessionState> m_sessions;
+};
+
+class GameServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    GameServer(const QSharedPointer<const Story> &story, int threadCount,
+               QObject *parent = nullptr);
+    ~GameServer();
+
+    int threadCount() const;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    QVector<QThread *> m_threads;
+    QVector<ServerWorker *> m_workers;
+    int m_nextWorker = 0;
+};
+
+#endif
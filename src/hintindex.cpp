@@ -0,0 +1,161 @@
+#include "hintindex.h"
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <functional>
+#include <memory>
+
+namespace {
+
+const int ParallelThreshold = 4096;
+
+using ChunkFunction = std::function<void(int chunk, int begin, int end)>;
+
+class ChunkTask : public QRunnable {
+public:
+  ChunkTask(const ChunkFunction &function, int chunk, int begin, int end)
+      : m_function(function), m_chunk(chunk), m_begin(begin), m_end(end) {}
+
+  void run() override { m_function(m_chunk, m_begin, m_end); }
+
+private:
+  const ChunkFunction &m_function;
+  int m_chunk;
+  int m_begin;
+  int m_end;
+};
+
+int chunkCount(int size, int threadCount) {
+  return size < ParallelThreshold ? 1 : qMin(threadCount, size);
+}
+
+void forChunks(int size, int chunks, const ChunkFunction &function) {
+  if (chunks <= 1) {
+    function(0, 0, size);
+    return;
+  }
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(chunks);
+  for (int chunk = 0; chunk < chunks; ++chunk) {
+    const qint64 begin = qint64(size) * chunk / chunks;
+    const qint64 end = qint64(size) * (chunk + 1) / chunks;
+    pool.start(new ChunkTask(function, chunk, int(begin), int(end)));
+  }
+  pool.waitForDone();
+}
+
+} // namespace
+
+bool StoryHint::isValid() const { return distance >= 0; }
+
+HintIndex::HintIndex() {}
+
+void HintIndex::build(const StoryGraph &graph, int threadCount) {
+  const int nodeCount = graph.nodeCount();
+  if (threadCount <= 0) {
+    threadCount = QThread::idealThreadCount();
+  }
+
+  QVector<int> firstSource(nodeCount + 1, 0);
+  for (int node = 0; node < nodeCount; ++node) {
+    const StoryNode &storyNode = graph.node(node);
+    for (int i = 0; i < storyNode.choiceCount(); ++i) {
+      const int target = storyNode.choice(i).targetNode();
+      if (target >= 0) {
+        ++firstSource[target + 1];
+      }
+    }
+  }
+  for (int node = 0; node < nodeCount; ++node) {
+    firstSource[node + 1] += firstSource[node];
+  }
+
+  QVector<int> sources(firstSource[nodeCount]);
+  QVector<int> fill = firstSource;
+  for (int node = 0; node < nodeCount; ++node) {
+    const StoryNode &storyNode = graph.node(node);
+    for (int i = 0; i < storyNode.choiceCount(); ++i) {
+      const int target = storyNode.choice(i).targetNode();
+      if (target >= 0) {
+        sources[fill[target]++] = node;
+      }
+    }
+  }
+  fill.clear();
+
+  std::unique_ptr<QAtomicInt[]> distance(new QAtomicInt[nodeCount]);
+  m_hints = QVector<StoryHint>(nodeCount);
+  QVector<int> frontier;
+  for (int node = 0; node < nodeCount; ++node) {
+    if (graph.node(node).isEndNode()) {
+      distance[node].storeRelease(0);
+      m_hints[node].distance = 0;
+      m_hints[node].ending = node;
+      frontier.append(node);
+    } else {
+      distance[node].storeRelease(-1);
+    }
+  }
+
+  const int *first = firstSource.constData();
+  const int *source = sources.constData();
+  StoryHint *hints = m_hints.data();
+  for (int depth = 1; !frontier.isEmpty(); ++depth) {
+    const int chunks = chunkCount(frontier.size(), threadCount);
+    QVector<QVector<int>> discovered(chunks);
+    QVector<int> *outputs = discovered.data();
+    const int *previous = frontier.constData();
+    forChunks(frontier.size(), chunks, [&](int chunk, int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        const int node = previous[i];
+        for (int s = first[node]; s < first[node + 1]; ++s) {
+          if (distance[source[s]].testAndSetRelaxed(-1, depth)) {
+            outputs[chunk].append(source[s]);
+          }
+        }
+      }
+    });
+
+    frontier.clear();
+    for (const QVector<int> &out : qAsConst(discovered)) {
+      frontier += out;
+    }
+
+    const int *current = frontier.constData();
+    forChunks(frontier.size(), chunkCount(frontier.size(), threadCount),
+              [&](int, int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                  const int node = current[i];
+                  const StoryNode &storyNode = graph.node(node);
+                  for (int c = 0; c < storyNode.choiceCount(); ++c) {
+                    const int target = storyNode.choice(c).targetNode();
+                    if (target >= 0 &&
+                        distance[target].loadAcquire() == depth - 1) {
+                      hints[node].distance = depth;
+                      hints[node].choice = c;
+                      hints[node].ending = hints[target].ending;
+                      break;
+                    }
+                  }
+                }
+              });
+  }
+  m_hints.squeeze();
+}
+
+void HintIndex::clear() { m_hints.clear(); }
+
+StoryHint HintIndex::hint(int node) const {
+  if (node < 0 || node >= m_hints.size()) {
+    return StoryHint();
+  }
+  return m_hints[node];
+}
+
+int HintIndex::nodeCount() const { return m_hints.size(); }
+
+qint64 HintIndex::memoryBytes() const {
+  return qint64(m_hints.capacity()) * sizeof(StoryHint);
+}
@@ -0,0 +1,33 @@
+#ifndef HINTINDEX_H
+#define HINTINDEX_H
+
+#include <QVector>
+#include "storygraph.h"
+
+struct StoryHint {
+    int distance = -1;
+    int choice = -1;
+    int ending = -1;
+
+    bool isValid() const;
+};
+
+Q_DECLARE_TYPEINFO(StoryHint, Q_PRIMITIVE_TYPE);
+
+class HintIndex
+{
+public:
+    HintIndex();
+
+    void build(const StoryGraph &graph, int threadCount = 0);
+    void clear();
+
+    StoryHint hint(int node) const;
+    int nodeCount() const;
+    qint64 memoryBytes() const;
+
+private:
+    QVector<StoryHint> m_hints;
+};
+
+#endif
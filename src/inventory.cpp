@@ -0,0 +1,93 @@
+#include "inventory.h"
+
+void Inventory::grant(int item) {
+  if (item < 0) {
+    return;
+  }
+
+  m_grants.append(item);
+  add(item);
+}
+
+void Inventory::truncate(int grantCount) {
+  while (m_grants.size() > qMax(0, grantCount)) {
+    const int item = m_grants.last();
+    m_grants.removeLast();
+    revoke(item);
+  }
+}
+
+void Inventory::reset(const QVector<int> &grants) {
+  m_grants.clear();
+  m_counts.clear();
+  m_rows.clear();
+  m_items.clear();
+  for (int item : grants) {
+    grant(item);
+  }
+
+  m_changes.clear();
+  record(InventoryChange::Reset, -1, -1);
+}
+
+void Inventory::clear() { reset(QVector<int>()); }
+
+int Inventory::count(int item) const {
+  return item >= 0 && item < m_counts.size() ? m_counts[item] : 0;
+}
+
+bool Inventory::contains(int item) const { return count(item) > 0; }
+
+int Inventory::size() const { return m_items.size(); }
+
+bool Inventory::isEmpty() const { return m_items.isEmpty(); }
+
+const QVector<int> &Inventory::items() const { return m_items; }
+
+int Inventory::grantCount() const { return m_grants.size(); }
+
+const QVector<int> &Inventory::grants() const { return m_grants; }
+
+QVector<InventoryChange> Inventory::takeChanges() {
+  QVector<InventoryChange> changes;
+  changes.swap(m_changes);
+  return changes;
+}
+
+void Inventory::add(int item) {
+  if (item >= m_counts.size()) {
+    m_counts.resize(item + 1);
+    m_rows.resize(item + 1);
+  }
+
+  if (m_counts[item]++ == 0) {
+    m_rows[item] = m_items.size();
+    m_items.append(item);
+    record(InventoryChange::Inserted, item, m_rows[item]);
+  } else {
+    record(InventoryChange::Updated, item, m_rows[item]);
+  }
+}
+
+void Inventory::revoke(int item) {
+  const int row = m_rows[item];
+  if (--m_counts[item] > 0) {
+    record(InventoryChange::Updated, item, row);
+    return;
+  }
+
+  m_items.remove(row);
+  for (int i = row; i < m_items.size(); ++i) {
+    m_rows[m_items[i]] = i;
+  }
+  record(InventoryChange::Removed, item, row);
+}
+
+void Inventory::record(InventoryChange::Type type, int item, int row) {
+  InventoryChange change;
+  change.type = type;
+  change.item = item;
+  change.row = row;
+  change.count = count(item);
+  m_changes.append(change);
+}
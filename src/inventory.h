@@ -0,0 +1,48 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <QVector>
+
+struct InventoryChange {
+    enum Type { Inserted, Updated, Removed, Reset };
+
+    Type type = Reset;
+    int item = -1;
+    int row = -1;
+    int count = 0;
+};
+
+Q_DECLARE_TYPEINFO(InventoryChange, Q_PRIMITIVE_TYPE);
+
+class Inventory
+{
+public:
+    void grant(int item);
+    void truncate(int grantCount);
+    void reset(const QVector<int> &grants);
+    void clear();
+
+    int count(int item) const;
+    bool contains(int item) const;
+    int size() const;
+    bool isEmpty() const;
+    const QVector<int> &items() const;
+
+    int grantCount() const;
+    const QVector<int> &grants() const;
+
+    QVector<InventoryChange> takeChanges();
+
+private:
+    void add(int item);
+    void revoke(int item);
+    void record(InventoryChange::Type type, int item, int row);
+
+    QVector<int> m_grants;
+    QVector<int> m_counts;
+    QVector<int> m_rows;
+    QVector<int> m_items;
+    QVector<InventoryChange> m_changes;
+};
+
+#endif
@@ -1,20 +1,68 @@
 #include "gameengine.h"
 #include "mainwindow.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
 #include <QProcessEnvironment>
+#include <QSaveFile>
 
 int main(int argc, char *argv[]) {
-  qputenv("QT_QPA_PLATFORM", "xcb");
-
   QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
   QApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
 
   QApplication app(argc, argv);
 
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  parser.addOption({"hot-reload",
+                    "Load story JSON files from <dir> and reload them when "
+                    "they change on disk.",
+                    "dir"});
+  parser.addOption({"session",
+                    "Resume the session saved in <file> and save it there "
+                    "on exit.",
+                    "file"});
+  parser.process(app);
+
   GameEngine gameEngine;
 
+  if (parser.isSet("hot-reload")) {
+    const QDir storyDir(parser.value("hot-reload"));
+    QStringList storyFiles;
+    const QStringList entries =
+        storyDir.entryList({"*.json"}, QDir::Files, QDir::Name);
+    for (const QString &entry : entries) {
+      storyFiles.append(storyDir.absoluteFilePath(entry));
+    }
+    gameEngine.setStoryFiles(storyFiles);
+    gameEngine.setHotReloadEnabled(true);
+  }
+
   MainWindow window(&gameEngine);
   window.show();
 
+  const QString sessionPath = parser.value("session");
+  if (!sessionPath.isEmpty()) {
+    QFile sessionFile(sessionPath);
+    if (sessionFile.open(QIODevice::ReadOnly)) {
+      QString errorMsg;
+      if (!gameEngine.loadState(sessionFile.readAll(), errorMsg)) {
+        qWarning() << "Could not resume session:" << errorMsg;
+      }
+    }
+
+    QObject::connect(&app, &QApplication::aboutToQuit, [&gameEngine,
+                                                        sessionPath]() {
+      QSaveFile sessionFile(sessionPath);
+      const QByteArray state = gameEngine.saveState();
+      if (state.isEmpty() || !sessionFile.open(QIODevice::WriteOnly) ||
+          sessionFile.write(state) != state.size() || !sessionFile.commit()) {
+        qWarning() << "Could not save session to" << sessionPath;
+      }
+    });
+  }
+
   return app.exec();
 }
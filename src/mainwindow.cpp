@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "timingwheel.h"
 #include <QApplication>
 #include <QGuiApplication>
 #include <QKeyEvent>
@@ -11,8 +12,8 @@
 MainWindow::MainWindow(GameEngine *gameEngine, QWidget *parent)
     : QMainWindow(parent), m_gameEngine(gameEngine), m_statsLabel(nullptr),
       m_progressLabel(nullptr), m_inventoryLabel(nullptr),
-      m_achievementsLabel(nullptr), m_animationGroup(nullptr),
-      m_storyFadeAnimation(nullptr) {
+      m_inventoryList(nullptr), m_achievementsLabel(nullptr),
+      m_animationGroup(nullptr), m_storyFadeAnimation(nullptr) {
   QScreen *screen = QGuiApplication::primaryScreen();
   QRect screenGeometry = screen->availableGeometry();
   qreal dpiScale = screen->logicalDotsPerInch() / 96.0;
@@ -43,9 +44,7 @@ MainWindow::MainWindow(GameEngine *gameEngine, QWidget *parent)
   statsLayout->setContentsMargins(statsPadding, smallPadding, statsPadding,
                                   smallPadding);
 
-  m_statsLabel = new QLabel("Qi Vitality: 100 | Spiritual Power: 10 | "
-                            "Comprehension: 10 | Fortune: 10",
-                            this);
+  m_statsLabel = new QLabel(this);
   m_statsLabel->setStyleSheet(QString("QLabel {"
                                       "  color: #FFD700;"
                                       "  font-weight: bold;"
@@ -64,7 +63,6 @@ MainWindow::MainWindow(GameEngine *gameEngine, QWidget *parent)
   statsLayout->addWidget(m_progressLabel);
 
   m_inventoryLabel = new QLabel("Items: none", this);
-  m_inventoryLabel->setWordWrap(true);
   m_inventoryLabel->setStyleSheet(QString("QLabel {"
                                           "  color: #90EE90;"
                                           "  font-weight: bold;"
@@ -73,6 +71,28 @@ MainWindow::MainWindow(GameEngine *gameEngine, QWidget *parent)
                                       .arg(baseFontSize));
   statsLayout->addWidget(m_inventoryLabel);
 
+  m_inventoryList = new QListWidget(this);
+  m_inventoryList->setFlow(QListView::LeftToRight);
+  m_inventoryList->setWrapping(true);
+  m_inventoryList->setUniformItemSizes(true);
+  m_inventoryList->setFocusPolicy(Qt::NoFocus);
+  m_inventoryList->setSelectionMode(QAbstractItemView::NoSelection);
+  m_inventoryList->setMaximumHeight(static_cast<int>(60 * dpiScale));
+  m_inventoryList->setStyleSheet(QString("QListWidget {"
+                                         "  background: transparent;"
+                                         "  border: none;"
+                                         "  color: #90EE90;"
+                                         "  font-weight: bold;"
+                                         "  font-size: %1px;"
+                                         "}"
+                                         "QListWidget::item {"
+                                         "  padding: 0px %2px;"
+                                         "}")
+                                     .arg(baseFontSize)
+                                     .arg(smallPadding));
+  m_inventoryList->setVisible(false);
+  statsLayout->addWidget(m_inventoryList, 1);
+
   m_achievementsLabel = new QLabel("Endings: 0", this);
   m_achievementsLabel->setStyleSheet(QString("QLabel {"
                                              "  color: #FF69B4;"
@@ -208,35 +228,16 @@ MainWindow::MainWindow(GameEngine *gameEngine, QWidget *parent)
                 "  background-color: #0f1a25;"
                 "}");
 
-  connect(m_gameEngine, &GameEngine::currentTextChanged, this,
-          &MainWindow::onStoryTextChanged);
-  connect(m_gameEngine, &GameEngine::choicesChanged, this,
-          &MainWindow::onChoicesChanged);
-  connect(m_gameEngine, &GameEngine::canGoBackChanged, this,
-          &MainWindow::onCanGoBackChanged);
+  connect(m_gameEngine, &GameEngine::stateChanged, this,
+          &MainWindow::onStateChanged);
   connect(m_gameEngine, &GameEngine::gameEnded, this, &MainWindow::onGameEnded);
   connect(m_gameEngine, &GameEngine::gameOver, this, &MainWindow::onGameOver);
   connect(m_gameEngine, &GameEngine::errorOccurred, this,
           &MainWindow::onErrorOccurred);
-
-  connect(m_gameEngine, &GameEngine::healthChanged, this,
-          &MainWindow::onStatsChanged);
-  connect(m_gameEngine, &GameEngine::strengthChanged, this,
-          &MainWindow::onStatsChanged);
-  connect(m_gameEngine, &GameEngine::intelligenceChanged, this,
-          &MainWindow::onStatsChanged);
-  connect(m_gameEngine, &GameEngine::wisdomChanged, this,
-          &MainWindow::onStatsChanged);
-  connect(m_gameEngine, &GameEngine::choicesMadeChanged, this,
-          &MainWindow::onProgressChanged);
-  connect(m_gameEngine, &GameEngine::nodesVisitedChanged, this,
-          &MainWindow::onProgressChanged);
-  connect(m_gameEngine, &GameEngine::playTimeChanged, this,
-          &MainWindow::onProgressChanged);
-  connect(m_gameEngine, &GameEngine::inventoryChanged, this,
-          &MainWindow::onInventoryChanged);
-  connect(m_gameEngine, &GameEngine::endingsFoundChanged, this,
-          &MainWindow::onProgressChanged);
+  connect(m_gameEngine, &GameEngine::inventoryItemsChanged, this,
+          &MainWindow::onInventoryItemsChanged);
+  connect(qApp, &QGuiApplication::applicationStateChanged, this,
+          &MainWindow::onApplicationStateChanged);
 
   m_gameEngine->loadStory(":/stories/story.json");
   m_titleLabel->setText(m_gameEngine->storyTitle());
@@ -245,7 +246,31 @@ MainWindow::MainWindow(GameEngine *gameEngine, QWidget *parent)
   setFocus();
 }
 
-MainWindow::~MainWindow() {}
+MainWindow::~MainWindow() {
+  if (m_clockRefresh) {
+    TimingWheel::shared()->cancel(m_clockRefresh);
+  }
+}
+
+void MainWindow::onStateChanged(GameEngine::DirtyMask changes) {
+  noteInteraction();
+  if (changes & GameEngine::TextDirty) {
+    onStoryTextChanged();
+  }
+  if (changes & GameEngine::ChoicesDirty) {
+    onChoicesChanged();
+  }
+  if (changes & GameEngine::CanGoBackDirty) {
+    onCanGoBackChanged();
+  }
+  if (changes & GameEngine::StatsDirty) {
+    onStatsChanged();
+  }
+  if (changes & (GameEngine::ChoicesMadeDirty | GameEngine::NodesVisitedDirty |
+                 GameEngine::PlayTimeDirty | GameEngine::EndingsDirty)) {
+    onProgressChanged();
+  }
+}
 
 void MainWindow::onStoryTextChanged() {
   m_storyDisplay->setText(m_gameEngine->currentText());
@@ -270,8 +295,7 @@ void MainWindow::onChoicesChanged() {
 
     QPushButton *choiceButton = new QPushButton(choiceText, this);
 
-    bool wasPreviouslySelected = m_gameEngine->isChoicePreviouslySelected(
-        m_gameEngine->currentNodeId(), i);
+    bool wasPreviouslySelected = m_gameEngine->isChoicePreviouslySelected(i);
 
     if (wasPreviouslySelected) {
       choiceButton->setStyleSheet(QString("QPushButton {"
@@ -378,9 +402,6 @@ void MainWindow::onStatsChanged() {
     return;
 
   int health = m_gameEngine->health();
-  int strength = m_gameEngine->strength();
-  int intelligence = m_gameEngine->intelligence();
-  int wisdom = m_gameEngine->wisdom();
 
   if (m_lastHealth > 0 && health <= 0) {
     m_wasHealthZero = true;
@@ -389,12 +410,13 @@ void MainWindow::onStatsChanged() {
   }
   m_lastHealth = health;
 
-  m_statsLabel->setText(QString("Qi Vitality: %1 | Spiritual Power: %2 | "
-                                "Comprehension: %3 | Fortune: %4")
-                            .arg(health)
-                            .arg(strength)
-                            .arg(intelligence)
-                            .arg(wisdom));
+  QStringList stats;
+  for (int stat = 0; stat < m_gameEngine->statCount(); ++stat) {
+    stats.append(QString("%1: %2")
+                     .arg(m_gameEngine->statName(stat))
+                     .arg(m_gameEngine->statValue(stat)));
+  }
+  m_statsLabel->setText(stats.join(" | "));
 }
 
 void MainWindow::onProgressChanged() {
@@ -422,38 +444,57 @@ void MainWindow::onProgressChanged() {
 }
 
 void MainWindow::onInventoryChanged() {
-  if (!m_inventoryLabel)
+  if (!m_inventoryList)
     return;
 
-  QStringList inventory = m_gameEngine->inventory();
-  if (inventory.isEmpty()) {
-    m_inventoryLabel->setText("Items: none");
-  } else {
-    QString itemsText = "Items: ";
-    QString currentLine = "";
-
-    for (int i = 0; i < inventory.size(); ++i) {
-      QString item = inventory[i];
-      QString separator = (i < inventory.size() - 1) ? ", " : "";
-      QString testLine =
-          currentLine.isEmpty() ? item : currentLine + ", " + item;
-
-      if (testLine.length() > 80 && !currentLine.isEmpty()) {
-        itemsText += currentLine + "\n         ";
-        currentLine = item;
-      } else {
-        currentLine = testLine;
-      }
-    }
+  const Inventory &inventory = m_gameEngine->inventoryItems();
+  m_inventoryList->clear();
+  for (int item : inventory.items()) {
+    m_inventoryList->addItem(inventoryItemText(item, inventory.count(item)));
+  }
 
-    if (!currentLine.isEmpty()) {
-      itemsText += currentLine;
+  const bool empty = inventory.isEmpty();
+  m_inventoryLabel->setText(empty ? "Items: none" : "Items:");
+  m_inventoryList->setVisible(!empty);
+}
+
+void MainWindow::onInventoryItemsChanged(
+    const QVector<InventoryChange> &changes) {
+  if (!m_inventoryList)
+    return;
+
+  const bool wasEmpty = m_inventoryList->count() == 0;
+  for (const InventoryChange &change : changes) {
+    switch (change.type) {
+    case InventoryChange::Inserted:
+      m_inventoryList->insertItem(
+          change.row, inventoryItemText(change.item, change.count));
+      break;
+    case InventoryChange::Updated:
+      m_inventoryList->item(change.row)->setText(
+          inventoryItemText(change.item, change.count));
+      break;
+    case InventoryChange::Removed:
+      delete m_inventoryList->takeItem(change.row);
+      break;
+    case InventoryChange::Reset:
+      onInventoryChanged();
+      break;
     }
+  }
 
-    m_inventoryLabel->setText(itemsText);
+  const bool empty = m_inventoryList->count() == 0;
+  if (empty != wasEmpty) {
+    m_inventoryLabel->setText(empty ? "Items: none" : "Items:");
+    m_inventoryList->setVisible(!empty);
   }
 }
 
+QString MainWindow::inventoryItemText(int item, int count) const {
+  const QString name = m_gameEngine->itemName(item);
+  return count > 1 ? QString("%1 x%2").arg(name).arg(count) : name;
+}
+
 void MainWindow::onGameOver(const QString &reason) {
   m_endingLabel->setText("GAME OVER\n\n" + reason +
                          "\n\nClick Restart to begin a new journey.");
@@ -494,6 +535,7 @@ void MainWindow::animateStoryText() {
 }
 
 void MainWindow::keyPressEvent(QKeyEvent *event) {
+  noteInteraction();
   if (event->key() == Qt::Key_Up) {
     if (m_selectedChoiceIndex > 0) {
       m_selectedChoiceIndex--;
@@ -547,8 +589,8 @@ void MainWindow::highlightSelectedChoice() {
     int choicePadding = static_cast<int>(12 * dpiScale);
     int choiceFontSize = static_cast<int>(16 * dpiScale);
 
-    bool wasPreviouslySelected = m_gameEngine->isChoicePreviouslySelected(
-        m_gameEngine->currentNodeId(), buttonIndex);
+    bool wasPreviouslySelected =
+        m_gameEngine->isChoicePreviouslySelected(buttonIndex);
 
     if (buttonIndex == m_selectedChoiceIndex) {
       if (wasPreviouslySelected) {
@@ -633,3 +675,29 @@ void MainWindow::highlightSelectedChoice() {
     buttonIndex++;
   }
 }
+
+void MainWindow::onApplicationStateChanged(Qt::ApplicationState state) {
+  const bool active = state == Qt::ApplicationActive;
+  TimingWheel::shared()->setPaused(!active);
+  if (active) {
+    onProgressChanged();
+  }
+}
+
+void MainWindow::noteInteraction() {
+  m_lastInteraction.start();
+  if (!m_clockRefresh) {
+    m_clockRefresh = TimingWheel::shared()->schedule(
+        1000, this, [this]() { refreshClock(); });
+  }
+}
+
+void MainWindow::refreshClock() {
+  m_clockRefresh = 0;
+  onProgressChanged();
+  if (m_lastInteraction.isValid() &&
+      m_lastInteraction.elapsed() < ClockIdleTimeoutMs) {
+    m_clockRefresh = TimingWheel::shared()->schedule(
+        1000, this, [this]() { refreshClock(); });
+  }
+}
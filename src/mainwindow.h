@@ -7,8 +7,10 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
+#include <QListWidget>
 #include <QPropertyAnimation>
 #include <QSequentialAnimationGroup>
+#include <QElapsedTimer>
 #include "gameengine.h"
 
 class MainWindow : public QMainWindow
@@ -20,6 +22,7 @@ public:
     ~MainWindow();
 
 private slots:
+    void onStateChanged(GameEngine::DirtyMask changes);
     void onStoryTextChanged();
     void onChoicesChanged();
     void onCanGoBackChanged();
@@ -31,11 +34,18 @@ private slots:
     void onRestartClicked();
     void onStatsChanged();
     void onInventoryChanged();
+    void onInventoryItemsChanged(const QVector<InventoryChange> &changes);
     void onProgressChanged();
     void animateStoryText();
+    void onApplicationStateChanged(Qt::ApplicationState state);
 
 private:
+    static const int ClockIdleTimeoutMs = 60000;
+
     void updateUI();
+    void noteInteraction();
+    void refreshClock();
+    QString inventoryItemText(int item, int count) const;
     void clearChoiceButtons();
     void keyPressEvent(QKeyEvent *event) override;
     void selectChoice(int index);
@@ -54,11 +64,15 @@ private:
     QLabel *m_statsLabel;
     QLabel *m_progressLabel;
     QLabel *m_inventoryLabel;
+    QListWidget *m_inventoryList;
     QLabel *m_achievementsLabel;
 
     QSequentialAnimationGroup *m_animationGroup;
     QPropertyAnimation *m_storyFadeAnimation;
 
+    QElapsedTimer m_lastInteraction;
+    int m_clockRefresh = 0;
+
     int m_lastHealth = 100;
     bool m_wasHealthZero = false;
 };
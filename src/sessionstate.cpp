@@ -0,0 +1,114 @@
+#include "sessionstate.h"
+#include <limits>
+
+void SessionState::start(const Story &story) {
+  node = story.startNode();
+  stats = story.rules().initialStats();
+  inventory.clear();
+  visited.clear();
+  history.clear();
+  checkpoints.clear();
+}
+
+bool SessionState::makeChoice(const Story &story, int choice) {
+  const StoryRules &rules = story.rules();
+  if (node < 0 || choice < 0 || choice >= rules.transitionCount(node) ||
+      choice > std::numeric_limits<quint16>::max()) {
+    return false;
+  }
+
+  const StoryRules::Transition &transition =
+      rules.transition(rules.firstTransition(node) + choice);
+  if (transition.target < 0) {
+    return false;
+  }
+
+  if (history.size() % CheckpointInterval == 0) {
+    Checkpoint checkpoint;
+    checkpoint.node = node;
+    checkpoint.stats = stats;
+    checkpoint.inventory = inventory;
+    checkpoints.append(checkpoint);
+  }
+
+  const int previous = node;
+  apply(rules, transition);
+  if (node != previous) {
+    visited.set(node);
+  }
+
+  history.append(quint16(choice));
+  if (history.size() > MaxHistory) {
+    history.remove(0, CheckpointInterval);
+    checkpoints.removeFirst();
+  }
+  return true;
+}
+
+bool SessionState::rewind(const Story &story, int steps) {
+  if (steps <= 0 || history.isEmpty()) {
+    return false;
+  }
+
+  const int target = history.size() - qMin(steps, history.size());
+  const int first = target / CheckpointInterval;
+  const Checkpoint checkpoint = checkpoints[first];
+  const int previous = node;
+  node = checkpoint.node;
+  stats = checkpoint.stats;
+  inventory = checkpoint.inventory;
+
+  const StoryRules &rules = story.rules();
+  for (int i = first * CheckpointInterval; i < target; ++i) {
+    apply(rules, rules.transition(rules.firstTransition(node) + history[i]));
+  }
+  history.resize(target);
+  checkpoints.resize((target + CheckpointInterval - 1) / CheckpointInterval);
+
+  if (node != previous) {
+    visited.set(node);
+  }
+  return true;
+}
+
+bool SessionState::isEnded(const Story &story) const {
+  return node >= 0 && story.graph().node(node).isEndNode();
+}
+
+bool SessionState::hasVisited(int visitedNode) const {
+  return visited.test(visitedNode);
+}
+
+int SessionState::visitedCount() const { return visited.count(); }
+
+int SessionState::itemCount(int item) const {
+  return item >= 0 && item < inventory.size() ? inventory[item] : 0;
+}
+
+qint64 SessionState::memoryBytes() const {
+  qint64 bytes = qint64(sizeof(SessionState)) +
+                 stats.capacity() * sizeof(int) +
+                 inventory.capacity() * sizeof(quint16) +
+                 visited.memoryBytes() + history.capacity() * sizeof(quint16) +
+                 checkpoints.capacity() * sizeof(Checkpoint);
+  for (const Checkpoint &checkpoint : checkpoints) {
+    bytes += checkpoint.stats.capacity() * sizeof(int) +
+             checkpoint.inventory.capacity() * sizeof(quint16);
+  }
+  return bytes;
+}
+
+void SessionState::apply(const StoryRules &rules,
+                         const StoryRules::Transition &transition) {
+  rules.applyStats(transition, stats.data());
+  for (int i = 0; i < transition.itemCount; ++i) {
+    const int item = rules.item(transition.firstItem + i);
+    if (item >= inventory.size()) {
+      inventory.resize(item + 1);
+    }
+    if (inventory[item] < std::numeric_limits<quint16>::max()) {
+      ++inventory[item];
+    }
+  }
+  node = transition.target;
+}
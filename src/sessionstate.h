@@ -0,0 +1,40 @@
+#ifndef SESSIONSTATE_H
+#define SESSIONSTATE_H
+
+#include <QVector>
+#include <QtGlobal>
+#include "bitset.h"
+#include "story.h"
+
+struct SessionState {
+    struct Checkpoint {
+        int node = -1;
+        QVector<int> stats;
+        QVector<quint16> inventory;
+    };
+
+    static const int CheckpointInterval = 32;
+    static const int MaxHistory = 1024;
+
+    int node = -1;
+    QVector<int> stats;
+    QVector<quint16> inventory;
+    Bitset visited;
+    QVector<quint16> history;
+    QVector<Checkpoint> checkpoints;
+
+    void start(const Story &story);
+    bool makeChoice(const Story &story, int choice);
+    bool rewind(const Story &story, int steps);
+
+    bool isEnded(const Story &story) const;
+    bool hasVisited(int visitedNode) const;
+    int visitedCount() const;
+    int itemCount(int item) const;
+    qint64 memoryBytes() const;
+
+private:
+    void apply(const StoryRules &rules, const StoryRules::Transition &transition);
+};
+
+#endif
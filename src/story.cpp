@@ -0,0 +1,103 @@
+#include "story.h"
+#include <numeric>
+
+QSharedPointer<Story> Story::load(const QStringList &filePaths,
+                                  const StoryLoadOptions &options,
+                                  QString &errorMsg) {
+  LoadedStory loaded = StoryLoader::loadStory(filePaths, options);
+  if (loaded.hasErrors()) {
+    errorMsg = loaded.errorString();
+    return QSharedPointer<Story>();
+  }
+
+  const int startNode = loaded.graph->findNode(loaded.startNodeId);
+  if (startNode < 0) {
+    errorMsg = "Start node not found: " + loaded.startNodeId;
+    return QSharedPointer<Story>();
+  }
+
+  QSharedPointer<Story> story(new Story);
+  story->m_graph = loaded.graph;
+  story->m_title = loaded.title;
+  story->m_files = filePaths;
+  story->m_compiled = !loaded.compiledPath.isEmpty();
+  story->m_startNode = startNode;
+  story->resolve(options);
+  return story;
+}
+
+const StoryGraph &Story::graph() const { return *m_graph; }
+
+QString Story::title() const { return m_title; }
+
+QStringList Story::files() const { return m_files; }
+
+bool Story::isCompiled() const { return m_compiled; }
+
+int Story::startNode() const { return m_startNode; }
+
+quint64 Story::fingerprint() const { return m_fingerprint; }
+
+ConstSpan<StatDelta> Story::itemEffects(int item) const {
+  return m_graph->itemEffects(item);
+}
+
+const HintIndex &Story::hints() const {
+  if (m_hintsStale.loadAcquire()) {
+    QMutexLocker locker(&m_hintsMutex);
+    if (m_hintsStale.loadAcquire()) {
+      m_hints.build(*m_graph, m_hintThreads);
+      m_hintsStale.storeRelease(0);
+    }
+  }
+  return m_hints;
+}
+
+const StoryRules &Story::rules() const { return *m_rules; }
+
+QSharedPointer<Story> Story::clone() const {
+  QSharedPointer<Story> story(new Story);
+  story->m_graph = m_graph->clone();
+  story->m_title = m_title;
+  story->m_files = m_files;
+  story->m_compiled = m_compiled;
+  story->m_startNode = m_startNode;
+  story->m_fingerprint = m_fingerprint;
+  story->m_hintThreads = m_hintThreads;
+  {
+    QMutexLocker locker(&m_hintsMutex);
+    story->m_hints = m_hints;
+    story->m_hintsStale.storeRelease(m_hintsStale.loadAcquire());
+  }
+  story->m_rules.reset(new StoryRules(*m_rules, *story->m_graph));
+  return story;
+}
+
+StoryReload Story::reloadFile(int file, const QString &filePath,
+                              const StoryLoadOptions &options) {
+  const int itemCount = m_graph->symbols().items.size();
+  StoryReload reload =
+      StoryLoader::reloadFile(*m_graph, file, filePath, options);
+
+  m_fingerprint = m_graph->fingerprint();
+  m_hintThreads = options.threadCount;
+  m_hintsStale.storeRelease(1);
+
+  QVector<int> nodes = reload.diff.nodes;
+  for (int item : qAsConst(reload.declaredItems)) {
+    if (item < itemCount) {
+      nodes.resize(m_graph->nodeCount());
+      std::iota(nodes.begin(), nodes.end(), 0);
+      break;
+    }
+  }
+  reload.movedTransitions = m_rules->update(nodes);
+  return reload;
+}
+
+void Story::resolve(const StoryLoadOptions &options) {
+  m_fingerprint = m_graph->fingerprint();
+  m_hintThreads = options.threadCount;
+  m_hints.build(*m_graph, m_hintThreads);
+  m_rules.reset(new StoryRules(*m_graph));
+}
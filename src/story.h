@@ -0,0 +1,54 @@
+#ifndef STORY_H
+#define STORY_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "hintindex.h"
+#include "storyloader.h"
+#include "storyrules.h"
+
+class Story
+{
+public:
+    static QSharedPointer<Story> load(const QStringList &filePaths,
+                                      const StoryLoadOptions &options,
+                                      QString &errorMsg);
+
+    const StoryGraph &graph() const;
+    QString title() const;
+    QStringList files() const;
+    bool isCompiled() const;
+    int startNode() const;
+    quint64 fingerprint() const;
+    ConstSpan<StatDelta> itemEffects(int item) const;
+    const HintIndex &hints() const;
+    const StoryRules &rules() const;
+
+    QSharedPointer<Story> clone() const;
+    StoryReload reloadFile(int file, const QString &filePath,
+                           const StoryLoadOptions &options);
+
+private:
+    Story() = default;
+    Q_DISABLE_COPY(Story)
+
+    void resolve(const StoryLoadOptions &options);
+
+    QSharedPointer<StoryGraph> m_graph;
+    QString m_title;
+    QStringList m_files;
+    bool m_compiled = false;
+    int m_startNode = -1;
+    quint64 m_fingerprint = 0;
+    mutable HintIndex m_hints;
+    mutable QMutex m_hintsMutex;
+    mutable QAtomicInt m_hintsStale;
+    int m_hintThreads = 0;
+    QSharedPointer<StoryRules> m_rules;
+};
+
+#endif
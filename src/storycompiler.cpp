@@ -0,0 +1,248 @@
+#include "storycompiler.h"
+#include "storyformat.h"
+#include "storyloader.h"
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QVector>
+#include <cstring>
+
+namespace {
+
+class StringPool {
+public:
+  StoryFormat::StringRef add(const QString &text) {
+    auto it = m_refs.constFind(text);
+    if (it != m_refs.constEnd()) {
+      return it.value();
+    }
+
+    StoryFormat::StringRef ref;
+    ref.offset = static_cast<quint32>(m_data.size());
+    ref.length = static_cast<quint32>(text.size());
+    m_data.append(text);
+    m_refs.insert(text, ref);
+    return ref;
+  }
+
+  const QString &data() const { return m_data; }
+
+private:
+  QString m_data;
+  QHash<QString, StoryFormat::StringRef> m_refs;
+};
+
+template <typename T>
+void appendRecords(QByteArray &out, const QVector<T> &records) {
+  out.append(reinterpret_cast<const char *>(records.constData()),
+             records.size() * static_cast<int>(sizeof(T)));
+}
+
+} // namespace
+
+bool StoryCompiler::compile(const QStringList &inputFiles,
+                            const QString &outputPath, QString &errorMsg) {
+  errorMsg.clear();
+
+  if (inputFiles.isEmpty()) {
+    errorMsg = "No story files given";
+    return false;
+  }
+
+  StoryLoadOptions options;
+  options.threadCount = 0;
+  options.compiled = false;
+  LoadedStory story = StoryLoader::loadStory(inputFiles, options);
+  if (story.hasErrors()) {
+    errorMsg = story.errorString();
+    return false;
+  }
+
+  if (story.graph->findNode(story.startNodeId) < 0) {
+    errorMsg = "Start node not found: " + story.startNodeId;
+    return false;
+  }
+
+  QVector<CompiledSource> sources(inputFiles.size());
+  for (int i = 0; i < inputFiles.size(); ++i) {
+    if (!CompiledStory::describeSource(outputPath, inputFiles[i], sources[i],
+                                       errorMsg)) {
+      return false;
+    }
+  }
+
+  QByteArray data = serialize(*story.graph, story.title, story.startNodeId,
+                              sources);
+  story.graph.reset();
+
+  QSaveFile file(outputPath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    errorMsg = "Failed to open output file: " + outputPath;
+    return false;
+  }
+
+  if (file.write(data) != data.size() || !file.commit()) {
+    errorMsg = "Failed to write compiled story: " + outputPath;
+    return false;
+  }
+
+  return true;
+}
+
+QByteArray StoryCompiler::serialize(const StoryGraph &graph,
+                                    const QString &title,
+                                    const QString &startNodeId,
+                                    const QVector<CompiledSource> &sources) {
+  using namespace StoryFormat;
+
+  StringPool strings;
+  QVector<NodeRecord> nodeRecords;
+  QVector<ChoiceRecord> choiceRecords;
+  QVector<StatRecord> statRecords;
+  QVector<StringRef> itemRecords;
+  QVector<StatDefinitionRecord> statDefinitionRecords;
+  QVector<ItemDefinitionRecord> itemDefinitionRecords;
+  QVector<EffectRecord> effectRecords;
+  QVector<SourceRecord> sourceRecords;
+  nodeRecords.reserve(graph.nodeCount());
+  choiceRecords.reserve(graph.choiceCount());
+
+  for (int i = 0; i < graph.nodeCount(); ++i) {
+    const StoryNode &node = graph.node(i);
+
+    NodeRecord nodeRecord;
+    nodeRecord.id = strings.add(node.id());
+    nodeRecord.text = strings.add(node.text());
+    nodeRecord.firstChoice = static_cast<quint32>(choiceRecords.size());
+    nodeRecord.choiceCount = static_cast<quint32>(node.choiceCount());
+    nodeRecords.append(nodeRecord);
+
+    for (int c = 0; c < node.choiceCount(); ++c) {
+      const Choice &choice = node.choice(c);
+      const QMap<QString, int> stats = choice.statChanges();
+      const QStringList items = choice.itemsGained();
+
+      ChoiceRecord choiceRecord;
+      choiceRecord.text = strings.add(choice.text());
+      choiceRecord.target = strings.add(choice.targetNodeId());
+      choiceRecord.targetNode = choice.targetNode() >= 0
+                                    ? static_cast<quint32>(choice.targetNode())
+                                    : InvalidIndex;
+      choiceRecord.firstStat = static_cast<quint32>(statRecords.size());
+      choiceRecord.statCount = static_cast<quint32>(stats.size());
+      choiceRecord.firstItem = static_cast<quint32>(itemRecords.size());
+      choiceRecord.itemCount = static_cast<quint32>(items.size());
+      choiceRecords.append(choiceRecord);
+
+      for (auto stat = stats.constBegin(); stat != stats.constEnd(); ++stat) {
+        StatRecord statRecord;
+        statRecord.name = strings.add(stat.key());
+        statRecord.delta = stat.value();
+        statRecords.append(statRecord);
+      }
+
+      for (const QString &item : items) {
+        itemRecords.append(strings.add(item));
+      }
+    }
+  }
+
+  for (int stat = 0; stat < graph.statCount(); ++stat) {
+    const StatDefinition &definition = graph.statDefinition(stat);
+    StatDefinitionRecord record;
+    record.id = strings.add(definition.id);
+    record.name = strings.add(definition.name);
+    record.initial = definition.initial;
+    record.minimum = definition.minimum;
+    record.maximum = definition.maximum;
+    record.declared = definition.declared ? 1 : 0;
+    statDefinitionRecords.append(record);
+  }
+
+  for (int item = 0; item < graph.symbols().items.size(); ++item) {
+    const ConstSpan<StatDelta> effects = graph.itemEffects(item);
+    ItemDefinitionRecord record;
+    record.id = strings.add(graph.symbols().items.name(item));
+    record.firstEffect = static_cast<quint32>(effectRecords.size());
+    record.effectCount = static_cast<quint32>(effects.size());
+    record.declared = graph.isItemDeclared(item) ? 1 : 0;
+    itemDefinitionRecords.append(record);
+
+    for (const StatDelta &effect : effects) {
+      EffectRecord effectRecord;
+      effectRecord.stat = static_cast<quint32>(effect.stat);
+      effectRecord.delta = effect.delta;
+      effectRecords.append(effectRecord);
+    }
+  }
+
+  for (const CompiledSource &source : sources) {
+    SourceRecord record;
+    record.path = strings.add(source.path);
+    record.size = static_cast<quint32>(source.size);
+    record.checksum = source.checksum;
+    record.modifiedLow = static_cast<quint32>(quint64(source.modified));
+    record.modifiedHigh = static_cast<quint32>(quint64(source.modified) >> 32);
+    sourceRecords.append(record);
+  }
+
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = Magic;
+  header.version = Version;
+  header.nodeCount = static_cast<quint32>(nodeRecords.size());
+  header.choiceCount = static_cast<quint32>(choiceRecords.size());
+  header.statCount = static_cast<quint32>(statRecords.size());
+  header.itemCount = static_cast<quint32>(itemRecords.size());
+  header.statDefinitionCount =
+      static_cast<quint32>(statDefinitionRecords.size());
+  header.itemDefinitionCount =
+      static_cast<quint32>(itemDefinitionRecords.size());
+  header.effectCount = static_cast<quint32>(effectRecords.size());
+  header.sourceCount = static_cast<quint32>(sourceRecords.size());
+  header.title = strings.add(title);
+  header.startNode = strings.add(startNodeId);
+
+  quint32 offset = sizeof(Header);
+  header.nodesOffset = offset;
+  offset += header.nodeCount * sizeof(NodeRecord);
+  header.choicesOffset = offset;
+  offset += header.choiceCount * sizeof(ChoiceRecord);
+  header.statsOffset = offset;
+  offset += header.statCount * sizeof(StatRecord);
+  header.itemsOffset = offset;
+  offset += header.itemCount * sizeof(StringRef);
+  header.statDefinitionsOffset = offset;
+  offset += header.statDefinitionCount * sizeof(StatDefinitionRecord);
+  header.itemDefinitionsOffset = offset;
+  offset += header.itemDefinitionCount * sizeof(ItemDefinitionRecord);
+  header.effectsOffset = offset;
+  offset += header.effectCount * sizeof(EffectRecord);
+  header.sourcesOffset = offset;
+  offset += header.sourceCount * sizeof(SourceRecord);
+  header.stringsOffset = offset;
+  header.stringsLength = static_cast<quint32>(strings.data().size());
+  offset += header.stringsLength * sizeof(QChar);
+  header.fileSize = offset;
+
+  QByteArray body;
+  body.reserve(static_cast<int>(offset - sizeof(Header)));
+  appendRecords(body, nodeRecords);
+  appendRecords(body, choiceRecords);
+  appendRecords(body, statRecords);
+  appendRecords(body, itemRecords);
+  appendRecords(body, statDefinitionRecords);
+  appendRecords(body, itemDefinitionRecords);
+  appendRecords(body, effectRecords);
+  appendRecords(body, sourceRecords);
+  body.append(reinterpret_cast<const char *>(strings.data().constData()),
+              strings.data().size() * static_cast<int>(sizeof(QChar)));
+
+  header.checksum = checksum(body.constData(), body.size());
+
+  QByteArray out;
+  out.reserve(static_cast<int>(offset));
+  out.append(reinterpret_cast<const char *>(&header), sizeof(Header));
+  out.append(body);
+  return out;
+}
@@ -0,0 +1,19 @@
+#ifndef STORYCOMPILER_H
+#define STORYCOMPILER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include "compiledstory.h"
+#include "storygraph.h"
+
+class StoryCompiler
+{
+public:
+    static bool compile(const QStringList &inputFiles, const QString &outputPath, QString &errorMsg);
+    static QByteArray serialize(const StoryGraph &graph, const QString &title,
+                                const QString &startNodeId,
+                                const QVector<CompiledSource> &sources = QVector<CompiledSource>());
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "storyformat.h"
+
+namespace {
+
+struct Crc32Table {
+  quint32 entries[256];
+
+  Crc32Table() {
+    for (quint32 i = 0; i < 256; ++i) {
+      quint32 crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+      }
+      entries[i] = crc;
+    }
+  }
+};
+
+} // namespace
+
+quint32 StoryFormat::checksum(const char *data, qint64 size) {
+  static const Crc32Table table;
+
+  quint32 crc = 0xffffffffu;
+  const uchar *bytes = reinterpret_cast<const uchar *>(data);
+  for (qint64 i = 0; i < size; ++i) {
+    crc = table.entries[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffffu;
+}
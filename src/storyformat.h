@@ -0,0 +1,101 @@
+#ifndef STORYFORMAT_H
+#define STORYFORMAT_H
+
+#include <QtGlobal>
+
+namespace StoryFormat
+{
+    const quint32 Magic = 0x43535252;
+    const quint32 Version = 3;
+    const quint32 InvalidIndex = 0xffffffffu;
+
+    struct StringRef {
+        quint32 offset;
+        quint32 length;
+    };
+
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 fileSize;
+        quint32 checksum;
+
+        quint32 nodeCount;
+        quint32 choiceCount;
+        quint32 statCount;
+        quint32 itemCount;
+        quint32 statDefinitionCount;
+        quint32 itemDefinitionCount;
+        quint32 effectCount;
+        quint32 sourceCount;
+
+        quint32 nodesOffset;
+        quint32 choicesOffset;
+        quint32 statsOffset;
+        quint32 itemsOffset;
+        quint32 statDefinitionsOffset;
+        quint32 itemDefinitionsOffset;
+        quint32 effectsOffset;
+        quint32 sourcesOffset;
+        quint32 stringsOffset;
+        quint32 stringsLength;
+
+        StringRef title;
+        StringRef startNode;
+    };
+
+    struct NodeRecord {
+        StringRef id;
+        StringRef text;
+        quint32 firstChoice;
+        quint32 choiceCount;
+    };
+
+    struct ChoiceRecord {
+        StringRef text;
+        StringRef target;
+        quint32 targetNode;
+        quint32 firstStat;
+        quint32 statCount;
+        quint32 firstItem;
+        quint32 itemCount;
+    };
+
+    struct StatRecord {
+        StringRef name;
+        qint32 delta;
+    };
+
+    struct StatDefinitionRecord {
+        StringRef id;
+        StringRef name;
+        qint32 initial;
+        qint32 minimum;
+        qint32 maximum;
+        quint32 declared;
+    };
+
+    struct ItemDefinitionRecord {
+        StringRef id;
+        quint32 firstEffect;
+        quint32 effectCount;
+        quint32 declared;
+    };
+
+    struct EffectRecord {
+        quint32 stat;
+        qint32 delta;
+    };
+
+    struct SourceRecord {
+        StringRef path;
+        quint32 size;
+        quint32 checksum;
+        quint32 modifiedLow;
+        quint32 modifiedHigh;
+    };
+
+    quint32 checksum(const char *data, qint64 size);
+}
+
+#endif
@@ -0,0 +1,733 @@
+#include "storygraph.h"
+#include <QSet>
+#include "compiledstory.h"
+
+namespace {
+
+const quint64 FnvOffset = 14695981039346656037ull;
+const quint64 FnvPrime = 1099511628211ull;
+
+quint64 combineHash(quint64 hash, quint64 value) {
+  return (hash ^ value) * FnvPrime;
+}
+
+} // namespace
+
+StoryGraph::StoryGraph() {}
+
+QSharedPointer<StoryGraph> StoryGraph::clone() const {
+  QSharedPointer<StoryGraph> graph(new StoryGraph);
+  graph->m_strings = m_strings;
+  graph->m_nodes = m_nodes;
+  graph->m_choices = m_choices;
+  graph->m_statNames = m_statNames;
+  graph->m_statDeltas = m_statDeltas;
+  graph->m_itemNames = m_itemNames;
+  graph->m_itemSymbols = m_itemSymbols;
+  graph->m_symbols = m_symbols;
+  graph->m_statDefinitions = m_statDefinitions;
+  graph->m_itemEffectRanges = m_itemEffectRanges;
+  graph->m_itemEffects = m_itemEffects;
+  graph->m_fileNodes = m_fileNodes;
+  graph->m_dangling = m_dangling;
+  graph->m_textStore =
+      m_textStore ? m_textStore->clone() : QSharedPointer<StoryTextStore>();
+  graph->m_compiled = m_compiled;
+  graph->m_deadChars = m_deadChars;
+  graph->m_deadChoices = m_deadChoices;
+  graph->m_deadStats = m_deadStats;
+  graph->m_deadItems = m_deadItems;
+
+  for (StoryNode &node : graph->m_nodes) {
+    node.m_graph = graph.data();
+  }
+  for (Choice &choice : graph->m_choices) {
+    choice.m_graph = graph.data();
+  }
+  return graph;
+}
+
+int StoryGraph::nodeCount() const { return m_nodes.size(); }
+
+const StoryNode &StoryGraph::node(int index) const { return m_nodes[index]; }
+
+QStringRef StoryGraph::nodeId(int index) const {
+  return stringRef(m_nodes[index].m_id);
+}
+
+int StoryGraph::findNode(const QString &id) const {
+  return m_symbols.nodes.find(id);
+}
+
+int StoryGraph::choiceCount() const { return m_choices.size(); }
+
+const StorySymbols &StoryGraph::symbols() const { return m_symbols; }
+
+quint64 StoryGraph::fingerprint() const {
+  quint64 hash = FnvOffset;
+  hash = combineHash(hash, m_symbols.nodes.fingerprint());
+  hash = combineHash(hash, m_symbols.stats.fingerprint());
+  hash = combineHash(hash, m_symbols.items.fingerprint());
+  return hash;
+}
+
+int StoryGraph::statCount() const { return m_statDefinitions.size(); }
+
+const StatDefinition &StoryGraph::statDefinition(int stat) const {
+  return m_statDefinitions[stat];
+}
+
+int StoryGraph::adjustedStat(int stat, int value, int delta) const {
+  const StatDefinition &definition = m_statDefinitions[stat];
+  return int(qBound<qint64>(definition.minimum, qint64(value) + delta,
+                            definition.maximum));
+}
+
+bool StoryGraph::declareStat(const StatDefinition &declaration) {
+  StatDefinition definition = declaration;
+  if (definition.name.isEmpty()) {
+    definition.name = definition.id;
+  }
+  definition.maximum = qMax(definition.minimum, definition.maximum);
+  definition.initial =
+      qBound(definition.minimum, definition.initial, definition.maximum);
+
+  const int stat = m_symbols.stats.find(definition.id);
+  if (stat >= 0) {
+    if (m_statDefinitions[stat].declared) {
+      return false;
+    }
+    m_statDefinitions[stat] = definition;
+    return true;
+  }
+
+  m_symbols.stats.intern(definition.id);
+  m_statDefinitions.append(definition);
+  return true;
+}
+
+bool StoryGraph::declareItem(const ItemDefinition &definition) {
+  const int item = m_symbols.items.intern(definition.id);
+  if (!definition.declared) {
+    return true;
+  }
+  if (isItemDeclared(item)) {
+    return false;
+  }
+
+  while (m_itemEffectRanges.size() <= item) {
+    m_itemEffectRanges.append({-1, 0});
+  }
+
+  EffectRange &range = m_itemEffectRanges[item];
+  range.first = m_itemEffects.size();
+  for (const ItemEffect &effect : definition.effects) {
+    m_itemEffects.append({internStat(effect.stat), effect.delta});
+  }
+  range.count = m_itemEffects.size() - range.first;
+  return true;
+}
+
+ConstSpan<StatDelta> StoryGraph::itemEffects(int item) const {
+  if (item < 0 || item >= m_itemEffectRanges.size() ||
+      m_itemEffectRanges[item].count == 0) {
+    return ConstSpan<StatDelta>();
+  }
+
+  const EffectRange &range = m_itemEffectRanges[item];
+  return ConstSpan<StatDelta>(m_itemEffects.constData() + range.first,
+                              range.count);
+}
+
+bool StoryGraph::isItemDeclared(int item) const {
+  return item >= 0 && item < m_itemEffectRanges.size() &&
+         m_itemEffectRanges[item].first >= 0;
+}
+
+StoryTextStore *StoryGraph::textStore() const { return m_textStore.data(); }
+
+void StoryGraph::setTextStore(const QSharedPointer<StoryTextStore> &textStore) {
+  m_textStore = textStore;
+}
+
+void StoryGraph::clear() {
+  m_strings.clear();
+  m_nodes.clear();
+  m_choices.clear();
+  m_statNames.clear();
+  m_statDeltas.clear();
+  m_itemNames.clear();
+  m_itemSymbols.clear();
+  m_symbols = StorySymbols();
+  m_statDefinitions.clear();
+  m_itemEffectRanges.clear();
+  m_itemEffects.clear();
+  m_fileNodes.clear();
+  m_dangling.clear();
+  m_compiled.reset();
+  m_deadChars = 0;
+  m_deadChoices = 0;
+  m_deadStats = 0;
+  m_deadItems = 0;
+}
+
+StoryGraph::Mark StoryGraph::mark() const {
+  return {m_choices.size(), m_statNames.size(), m_itemNames.size()};
+}
+
+void StoryGraph::rollback(const Mark &mark) {
+  m_choices.remove(mark.choices, m_choices.size() - mark.choices);
+  rollbackStats(mark);
+  rollbackItems(mark);
+}
+
+void StoryGraph::rollbackStats(const Mark &mark) {
+  m_statNames.resize(mark.stats);
+  m_statDeltas.resize(mark.stats);
+}
+
+void StoryGraph::rollbackItems(const Mark &mark) {
+  m_itemNames.resize(mark.items);
+  m_itemSymbols.resize(mark.items);
+}
+
+void StoryGraph::addStat(const Mark &choiceStart, const QString &name,
+                         int delta) {
+  for (int i = choiceStart.stats; i < m_statNames.size(); ++i) {
+    const StoryStringRef &ref = m_statNames[i];
+    if (m_strings.midRef(ref.offset, ref.length) == name) {
+      m_statDeltas[i].delta = delta;
+      return;
+    }
+  }
+
+  m_statNames.append(addString(name));
+  m_statDeltas.append({-1, delta});
+}
+
+void StoryGraph::addItem(const QString &name) {
+  m_itemNames.append(addString(name));
+  m_itemSymbols.append(-1);
+}
+
+void StoryGraph::addChoice(const Mark &choiceStart, const QString &text,
+                           const QString &targetNodeId) {
+  Choice choice;
+  choice.m_graph = this;
+  choice.m_text = addString(text);
+  choice.m_targetNodeId = addString(targetNodeId);
+  choice.m_firstStat = choiceStart.stats;
+  choice.m_statCount = m_statNames.size() - choiceStart.stats;
+  choice.m_firstItem = choiceStart.items;
+  choice.m_itemCount = m_itemNames.size() - choiceStart.items;
+  m_choices.append(choice);
+}
+
+void StoryGraph::addNode(const Mark &nodeStart, const QString &id,
+                         const QString &text) {
+  StoryNode &node = appendNodeRecord(nodeStart, id);
+  node.m_text = addString(text);
+}
+
+void StoryGraph::addPagedNode(const Mark &nodeStart, const QString &id,
+                              int textSource, qint64 textOffset,
+                              int textLength) {
+  StoryNode &node = appendNodeRecord(nodeStart, id);
+  node.m_text.length = textLength;
+  node.m_textSource = textSource;
+  node.m_textOffset = textOffset;
+}
+
+int StoryGraph::appendStrings(const StoryGraph &source) {
+  const int base = m_strings.size();
+  m_strings.append(source.m_strings);
+  return base;
+}
+
+void StoryGraph::appendNode(const StoryGraph &source, int node,
+                            int stringBase, int file) {
+  StoryNode record = copyNode(source, node, stringBase, file);
+  record.m_symbol = m_nodes.size();
+  m_nodes.append(record);
+
+  if (m_fileNodes.size() <= file) {
+    m_fileNodes.resize(file + 1);
+  }
+  m_fileNodes[file].append(record.m_symbol);
+}
+
+void StoryGraph::loadCompiled(const QSharedPointer<CompiledStory> &compiled) {
+  using namespace StoryFormat;
+
+  clear();
+  m_compiled = compiled;
+
+  for (int stat = 0; stat < compiled->statDefinitionCount(); ++stat) {
+    declareStat(compiled->statDefinition(stat));
+  }
+  for (int item = 0; item < compiled->itemDefinitionCount(); ++item) {
+    declareItem(compiled->itemDefinition(item));
+  }
+
+  const Header &header = *compiled->m_header;
+  m_strings = QString::fromRawData(compiled->m_strings,
+                                   static_cast<int>(header.stringsLength));
+
+  m_statNames.reserve(static_cast<int>(header.statCount));
+  m_statDeltas.reserve(static_cast<int>(header.statCount));
+  for (quint32 i = 0; i < header.statCount; ++i) {
+    const StatRecord &record = compiled->m_stats[i];
+    const StoryStringRef name = {static_cast<int>(record.name.offset),
+                                 static_cast<int>(record.name.length)};
+    int stat = m_symbols.stats.find(stringRef(name));
+    if (stat < 0) {
+      stat = internStat(string(name));
+    }
+    m_statNames.append(name);
+    m_statDeltas.append({stat, record.delta});
+  }
+
+  m_itemNames.reserve(static_cast<int>(header.itemCount));
+  m_itemSymbols.reserve(static_cast<int>(header.itemCount));
+  for (quint32 i = 0; i < header.itemCount; ++i) {
+    const StringRef &record = compiled->m_items[i];
+    const StoryStringRef name = {static_cast<int>(record.offset),
+                                 static_cast<int>(record.length)};
+    m_itemNames.append(name);
+    m_itemSymbols.append(m_symbols.items.intern(stringRef(name)));
+  }
+
+  m_choices.reserve(static_cast<int>(header.choiceCount));
+  for (quint32 i = 0; i < header.choiceCount; ++i) {
+    const ChoiceRecord &record = compiled->m_choices[i];
+    Choice choice;
+    choice.m_graph = this;
+    choice.m_text = {static_cast<int>(record.text.offset),
+                     static_cast<int>(record.text.length)};
+    choice.m_targetNodeId = {static_cast<int>(record.target.offset),
+                             static_cast<int>(record.target.length)};
+    choice.m_targetNode = record.targetNode == InvalidIndex
+                              ? -1
+                              : static_cast<int>(record.targetNode);
+    choice.m_firstStat = static_cast<int>(record.firstStat);
+    choice.m_statCount = static_cast<int>(record.statCount);
+    choice.m_firstItem = static_cast<int>(record.firstItem);
+    choice.m_itemCount = static_cast<int>(record.itemCount);
+    m_choices.append(choice);
+  }
+
+  m_nodes.reserve(static_cast<int>(header.nodeCount));
+  m_symbols.nodes.reserve(static_cast<int>(header.nodeCount));
+  for (quint32 i = 0; i < header.nodeCount; ++i) {
+    const NodeRecord &record = compiled->m_nodes[i];
+    StoryNode node;
+    node.m_graph = this;
+    node.m_id = {static_cast<int>(record.id.offset),
+                 static_cast<int>(record.id.length)};
+    node.m_text = {static_cast<int>(record.text.offset),
+                   static_cast<int>(record.text.length)};
+    node.m_symbol = m_symbols.nodes.intern(stringRef(node.m_id));
+    node.m_firstChoice = static_cast<int>(record.firstChoice);
+    node.m_choiceCount = static_cast<int>(record.choiceCount);
+    m_nodes.append(node);
+
+    for (int choice = 0; choice < node.m_choiceCount; ++choice) {
+      if (m_choices[node.m_firstChoice + choice].m_targetNode < 0) {
+        m_dangling.append(qMakePair(node.m_symbol, choice));
+      }
+    }
+  }
+}
+
+int StoryGraph::nodeFile(int index) const { return m_nodes[index].m_file; }
+
+QVector<int> StoryGraph::fileNodes(int file) const {
+  return m_fileNodes.value(file);
+}
+
+StoryGraph::FileDiff StoryGraph::replaceFile(const StoryGraph &source,
+                                             const QVector<int> &nodes,
+                                             int file) {
+  FileDiff diff;
+  if (m_fileNodes.size() <= file) {
+    m_fileNodes.resize(file + 1);
+  }
+
+  const int firstStat = m_statNames.size();
+  const int firstItem = m_itemNames.size();
+  QVector<int> fileNodes;
+  QSet<int> touched;
+  fileNodes.reserve(nodes.size());
+
+  for (int node : nodes) {
+    const QStringRef id = source.stringRef(source.m_nodes[node].m_id);
+    int symbol = m_symbols.nodes.find(id);
+
+    if (symbol >= 0 && m_nodes[symbol].m_file >= 0 &&
+        m_nodes[symbol].m_file != file) {
+      diff.duplicateIds.append(id.toString());
+      continue;
+    }
+
+    if (symbol < 0) {
+      symbol = m_symbols.nodes.intern(id);
+      StoryNode record = copyNode(source, node, -1, file);
+      record.m_symbol = symbol;
+      m_nodes.append(record);
+      touched.insert(symbol);
+      ++diff.added;
+    } else if (m_nodes[symbol].m_file != file ||
+               !sameNode(m_nodes[symbol], source, source.m_nodes[node])) {
+      releaseNode(m_nodes[symbol]);
+      StoryNode record = copyNode(source, node, -1, file);
+      record.m_symbol = symbol;
+      record.m_id = m_nodes[symbol].m_id;
+      m_nodes[symbol] = record;
+      touched.insert(symbol);
+      ++diff.changed;
+    }
+
+    fileNodes.append(symbol);
+  }
+
+  QSet<int> kept;
+  kept.reserve(fileNodes.size());
+  for (int node : qAsConst(fileNodes)) {
+    kept.insert(node);
+  }
+  for (int node : qAsConst(m_fileNodes[file])) {
+    if (!kept.contains(node)) {
+      releaseNode(m_nodes[node]);
+      m_nodes[node].m_file = -1;
+      m_nodes[node].m_removed = true;
+      diff.nodes.append(node);
+      ++diff.removed;
+    }
+  }
+  m_fileNodes[file] = fileNodes;
+  for (int node : qAsConst(touched)) {
+    diff.nodes.append(node);
+  }
+
+  internRecords(firstStat, firstItem);
+
+  QVector<QPair<int, int>> dangling;
+  for (const QPair<int, int> &link : qAsConst(m_dangling)) {
+    if (!touched.contains(link.first) && !linkChoice(link.first, link.second)) {
+      dangling.append(link);
+    }
+  }
+  for (int node : qAsConst(touched)) {
+    for (int i = 0; i < m_nodes[node].m_choiceCount; ++i) {
+      if (!linkChoice(node, i)) {
+        dangling.append(qMakePair(node, i));
+      }
+    }
+  }
+  if (diff.removed > 0) {
+    for (int node = 0; node < m_nodes.size(); ++node) {
+      if (touched.contains(node)) {
+        continue;
+      }
+      for (int i = 0; i < m_nodes[node].m_choiceCount; ++i) {
+        Choice &choice = m_choices[m_nodes[node].m_firstChoice + i];
+        if (choice.m_targetNode >= 0 &&
+            m_nodes[choice.m_targetNode].m_removed) {
+          choice.m_targetNode = -1;
+          dangling.append(qMakePair(node, i));
+        }
+      }
+    }
+  }
+  m_dangling = dangling;
+
+  if (m_deadChoices * 2 > m_choices.size() ||
+      m_deadStats * 2 > m_statNames.size() ||
+      m_deadItems * 2 > m_itemNames.size() ||
+      m_deadChars * 2 > m_strings.size()) {
+    compact();
+  }
+
+  return diff;
+}
+
+void StoryGraph::internSymbols() {
+  m_symbols.nodes.reserve(m_nodes.size());
+  for (const StoryNode &node : qAsConst(m_nodes)) {
+    m_symbols.nodes.intern(string(node.m_id));
+  }
+
+  internRecords(0, 0);
+}
+
+void StoryGraph::linkChoices() {
+  m_dangling.clear();
+  for (int node = 0; node < m_nodes.size(); ++node) {
+    for (int i = 0; i < m_nodes[node].m_choiceCount; ++i) {
+      if (!linkChoice(node, i)) {
+        m_dangling.append(qMakePair(node, i));
+      }
+    }
+  }
+}
+
+const QVector<QPair<int, int>> &StoryGraph::danglingChoices() const {
+  return m_dangling;
+}
+
+StoryStringRef StoryGraph::addString(const QString &text) {
+  StoryStringRef ref;
+  ref.offset = m_strings.size();
+  ref.length = text.size();
+  m_strings.append(text);
+  return ref;
+}
+
+QString StoryGraph::string(const StoryStringRef &ref) const {
+  return QString(m_strings.constData() + ref.offset, ref.length);
+}
+
+QStringRef StoryGraph::stringRef(const StoryStringRef &ref) const {
+  return m_strings.midRef(ref.offset, ref.length);
+}
+
+StoryStringRef StoryGraph::importString(const StoryGraph &source,
+                                        const StoryStringRef &ref,
+                                        int stringBase) {
+  if (stringBase >= 0) {
+    return {ref.offset + stringBase, ref.length};
+  }
+
+  StoryStringRef imported;
+  imported.offset = m_strings.size();
+  imported.length = ref.length;
+  m_strings.append(source.m_strings.constData() + ref.offset, ref.length);
+  return imported;
+}
+
+StoryNode StoryGraph::copyNode(const StoryGraph &source, int node,
+                               int stringBase, int file) {
+  StoryNode record = source.m_nodes[node];
+  record.m_graph = this;
+  record.m_file = file;
+  record.m_id = importString(source, record.m_id, stringBase);
+  if (record.m_textSource < 0) {
+    record.m_text = importString(source, record.m_text, stringBase);
+  }
+
+  const int firstChoice = record.m_firstChoice;
+  record.m_firstChoice = m_choices.size();
+
+  for (int i = 0; i < record.m_choiceCount; ++i) {
+    Choice choice = source.m_choices[firstChoice + i];
+    choice.m_graph = this;
+    choice.m_targetNode = -1;
+    choice.m_text = importString(source, choice.m_text, stringBase);
+    choice.m_targetNodeId =
+        importString(source, choice.m_targetNodeId, stringBase);
+
+    const int firstStat = choice.m_firstStat;
+    choice.m_firstStat = m_statNames.size();
+    for (int stat = 0; stat < choice.m_statCount; ++stat) {
+      m_statNames.append(importString(
+          source, source.m_statNames[firstStat + stat], stringBase));
+      m_statDeltas.append(source.m_statDeltas[firstStat + stat]);
+    }
+
+    const int firstItem = choice.m_firstItem;
+    choice.m_firstItem = m_itemNames.size();
+    for (int item = 0; item < choice.m_itemCount; ++item) {
+      m_itemNames.append(importString(
+          source, source.m_itemNames[firstItem + item], stringBase));
+      m_itemSymbols.append(source.m_itemSymbols[firstItem + item]);
+    }
+
+    m_choices.append(choice);
+  }
+
+  return record;
+}
+
+bool StoryGraph::sameNode(const StoryNode &live, const StoryGraph &source,
+                          const StoryNode &node) const {
+  if (live.m_textSource >= 0 || node.m_textSource >= 0) {
+    if (live.m_textSource != node.m_textSource ||
+        live.m_text.length != node.m_text.length || !m_textStore ||
+        m_textStore->text(live.m_textSource, live.m_textOffset,
+                          live.m_text.length) !=
+            m_textStore->text(node.m_textSource, node.m_textOffset,
+                              node.m_text.length)) {
+      return false;
+    }
+  } else if (stringRef(live.m_text) != source.stringRef(node.m_text)) {
+    return false;
+  }
+
+  if (live.m_choiceCount != node.m_choiceCount) {
+    return false;
+  }
+
+  for (int i = 0; i < live.m_choiceCount; ++i) {
+    const Choice &a = m_choices[live.m_firstChoice + i];
+    const Choice &b = source.m_choices[node.m_firstChoice + i];
+    if (stringRef(a.m_text) != source.stringRef(b.m_text) ||
+        stringRef(a.m_targetNodeId) != source.stringRef(b.m_targetNodeId) ||
+        a.m_statCount != b.m_statCount || a.m_itemCount != b.m_itemCount) {
+      return false;
+    }
+
+    for (int stat = 0; stat < a.m_statCount; ++stat) {
+      const int x = a.m_firstStat + stat;
+      const int y = b.m_firstStat + stat;
+      if (m_statDeltas[x].delta != source.m_statDeltas[y].delta ||
+          stringRef(m_statNames[x]) !=
+              source.stringRef(source.m_statNames[y])) {
+        return false;
+      }
+    }
+
+    for (int item = 0; item < a.m_itemCount; ++item) {
+      if (stringRef(m_itemNames[a.m_firstItem + item]) !=
+          source.stringRef(source.m_itemNames[b.m_firstItem + item])) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+int StoryGraph::internStat(const QString &name) {
+  const int stat = m_symbols.stats.intern(name);
+  if (stat == m_statDefinitions.size()) {
+    StatDefinition definition;
+    definition.id = name;
+    definition.name = name;
+    definition.declared = false;
+    m_statDefinitions.append(definition);
+  }
+  return stat;
+}
+
+void StoryGraph::internRecords(int firstStat, int firstItem) {
+  for (int i = firstStat; i < m_statNames.size(); ++i) {
+    m_statDeltas[i].stat = internStat(string(m_statNames[i]));
+  }
+
+  for (int i = firstItem; i < m_itemNames.size(); ++i) {
+    m_itemSymbols[i] = m_symbols.items.intern(string(m_itemNames[i]));
+  }
+}
+
+bool StoryGraph::linkChoice(int node, int choice) {
+  Choice &record = m_choices[m_nodes[node].m_firstChoice + choice];
+  record.m_targetNode = m_symbols.nodes.find(stringRef(record.m_targetNodeId));
+  if (record.m_targetNode >= 0 && m_nodes[record.m_targetNode].m_removed) {
+    record.m_targetNode = -1;
+  }
+  return record.m_targetNode >= 0;
+}
+
+void StoryGraph::releaseNode(StoryNode &node) {
+  if (node.m_textSource < 0) {
+    m_deadChars += node.m_text.length;
+  }
+
+  for (int i = 0; i < node.m_choiceCount; ++i) {
+    const Choice &choice = m_choices[node.m_firstChoice + i];
+    m_deadChars += choice.m_text.length + choice.m_targetNodeId.length;
+    for (int stat = 0; stat < choice.m_statCount; ++stat) {
+      m_deadChars += m_statNames[choice.m_firstStat + stat].length;
+    }
+    for (int item = 0; item < choice.m_itemCount; ++item) {
+      m_deadChars += m_itemNames[choice.m_firstItem + item].length;
+    }
+    m_deadStats += choice.m_statCount;
+    m_deadItems += choice.m_itemCount;
+  }
+  m_deadChoices += node.m_choiceCount;
+
+  node.m_choiceCount = 0;
+  node.m_text.length = 0;
+  node.m_textSource = -1;
+  node.m_textOffset = 0;
+}
+
+StoryStringRef StoryGraph::keepString(QString &strings,
+                                      const StoryStringRef &ref) const {
+  StoryStringRef kept;
+  kept.offset = strings.size();
+  kept.length = ref.length;
+  strings.append(m_strings.constData() + ref.offset, ref.length);
+  return kept;
+}
+
+void StoryGraph::compact() {
+  QString strings;
+  QVector<Choice> choices;
+  QVector<StoryStringRef> statNames;
+  QVector<StatDelta> statDeltas;
+  QVector<StoryStringRef> itemNames;
+  QVector<int> itemSymbols;
+  strings.reserve(m_strings.size() - m_deadChars);
+  choices.reserve(m_choices.size() - m_deadChoices);
+  statNames.reserve(m_statNames.size() - m_deadStats);
+  statDeltas.reserve(m_statDeltas.size() - m_deadStats);
+  itemNames.reserve(m_itemNames.size() - m_deadItems);
+  itemSymbols.reserve(m_itemSymbols.size() - m_deadItems);
+
+  for (StoryNode &node : m_nodes) {
+    node.m_id = keepString(strings, node.m_id);
+    if (node.m_textSource < 0) {
+      node.m_text = keepString(strings, node.m_text);
+    }
+
+    const int firstChoice = node.m_firstChoice;
+    node.m_firstChoice = choices.size();
+    for (int i = 0; i < node.m_choiceCount; ++i) {
+      Choice choice = m_choices[firstChoice + i];
+      choice.m_text = keepString(strings, choice.m_text);
+      choice.m_targetNodeId = keepString(strings, choice.m_targetNodeId);
+
+      const int firstStat = choice.m_firstStat;
+      choice.m_firstStat = statNames.size();
+      for (int stat = 0; stat < choice.m_statCount; ++stat) {
+        statNames.append(keepString(strings, m_statNames[firstStat + stat]));
+        statDeltas.append(m_statDeltas[firstStat + stat]);
+      }
+
+      const int firstItem = choice.m_firstItem;
+      choice.m_firstItem = itemNames.size();
+      for (int item = 0; item < choice.m_itemCount; ++item) {
+        itemNames.append(keepString(strings, m_itemNames[firstItem + item]));
+        itemSymbols.append(m_itemSymbols[firstItem + item]);
+      }
+
+      choices.append(choice);
+    }
+  }
+
+  m_strings.swap(strings);
+  m_compiled.reset();
+  m_choices.swap(choices);
+  m_statNames.swap(statNames);
+  m_statDeltas.swap(statDeltas);
+  m_itemNames.swap(itemNames);
+  m_itemSymbols.swap(itemSymbols);
+  m_deadChars = 0;
+  m_deadChoices = 0;
+  m_deadStats = 0;
+  m_deadItems = 0;
+}
+
+StoryNode &StoryGraph::appendNodeRecord(const Mark &nodeStart,
+                                        const QString &id) {
+  StoryNode node;
+  node.m_graph = this;
+  node.m_id = addString(id);
+  node.m_symbol = m_nodes.size();
+  node.m_firstChoice = nodeStart.choices;
+  node.m_choiceCount = m_choices.size() - nodeStart.choices;
+  m_nodes.append(node);
+  return m_nodes.last();
+}
@@ -0,0 +1,147 @@
+#ifndef STORYGRAPH_H
+#define STORYGRAPH_H
+
+#include <QString>
+#include <QStringRef>
+#include <QStringList>
+#include <QVector>
+#include <QPair>
+#include <QSharedPointer>
+#include <limits>
+#include "constspan.h"
+#include "storynode.h"
+#include "storytextstore.h"
+#include "symboltable.h"
+
+class CompiledStory;
+
+struct StatDefinition {
+    QString id;
+    QString name;
+    int initial = 0;
+    int minimum = std::numeric_limits<int>::min();
+    int maximum = std::numeric_limits<int>::max();
+    bool declared = true;
+};
+
+struct ItemEffect {
+    QString stat;
+    int delta = 0;
+};
+
+struct ItemDefinition {
+    QString id;
+    QVector<ItemEffect> effects;
+    bool declared = true;
+};
+
+class StoryGraph
+{
+public:
+    struct Mark {
+        int choices;
+        int stats;
+        int items;
+    };
+
+    struct FileDiff {
+        int added = 0;
+        int changed = 0;
+        int removed = 0;
+        QStringList duplicateIds;
+        QVector<int> nodes;
+    };
+
+    StoryGraph();
+
+    QSharedPointer<StoryGraph> clone() const;
+
+    int nodeCount() const;
+    const StoryNode &node(int index) const;
+    QStringRef nodeId(int index) const;
+    int findNode(const QString &id) const;
+    int nodeFile(int index) const;
+    QVector<int> fileNodes(int file) const;
+    int choiceCount() const;
+    const StorySymbols &symbols() const;
+    quint64 fingerprint() const;
+    int statCount() const;
+    const StatDefinition &statDefinition(int stat) const;
+    int adjustedStat(int stat, int value, int delta) const;
+    bool declareStat(const StatDefinition &declaration);
+    bool declareItem(const ItemDefinition &definition);
+    ConstSpan<StatDelta> itemEffects(int item) const;
+    bool isItemDeclared(int item) const;
+
+    StoryTextStore *textStore() const;
+    void setTextStore(const QSharedPointer<StoryTextStore> &textStore);
+
+    void clear();
+    Mark mark() const;
+    void rollback(const Mark &mark);
+    void rollbackStats(const Mark &mark);
+    void rollbackItems(const Mark &mark);
+    void addStat(const Mark &choiceStart, const QString &name, int delta);
+    void addItem(const QString &name);
+    void addChoice(const Mark &choiceStart, const QString &text, const QString &targetNodeId);
+    void addNode(const Mark &nodeStart, const QString &id, const QString &text);
+    void addPagedNode(const Mark &nodeStart, const QString &id, int textSource,
+                      qint64 textOffset, int textLength);
+
+    int appendStrings(const StoryGraph &source);
+    void appendNode(const StoryGraph &source, int node, int stringBase, int file);
+    void loadCompiled(const QSharedPointer<CompiledStory> &compiled);
+    void internSymbols();
+    void linkChoices();
+    const QVector<QPair<int, int>> &danglingChoices() const;
+
+    FileDiff replaceFile(const StoryGraph &source, const QVector<int> &nodes, int file);
+
+private:
+    Q_DISABLE_COPY(StoryGraph)
+
+    friend class StoryNode;
+    friend class Choice;
+
+    struct EffectRange {
+        int first;
+        int count;
+    };
+
+    StoryStringRef addString(const QString &text);
+    QString string(const StoryStringRef &ref) const;
+    QStringRef stringRef(const StoryStringRef &ref) const;
+    StoryStringRef importString(const StoryGraph &source, const StoryStringRef &ref,
+                                int stringBase);
+    StoryNode &appendNodeRecord(const Mark &nodeStart, const QString &id);
+    StoryNode copyNode(const StoryGraph &source, int node, int stringBase, int file);
+    bool sameNode(const StoryNode &live, const StoryGraph &source, const StoryNode &node) const;
+    int internStat(const QString &name);
+    void internRecords(int firstStat, int firstItem);
+    bool linkChoice(int node, int choice);
+    void releaseNode(StoryNode &node);
+    StoryStringRef keepString(QString &strings, const StoryStringRef &ref) const;
+    void compact();
+
+    QString m_strings;
+    QVector<StoryNode> m_nodes;
+    QVector<Choice> m_choices;
+    QVector<StoryStringRef> m_statNames;
+    QVector<StatDelta> m_statDeltas;
+    QVector<StoryStringRef> m_itemNames;
+    QVector<int> m_itemSymbols;
+    StorySymbols m_symbols;
+    QVector<StatDefinition> m_statDefinitions;
+    QVector<EffectRange> m_itemEffectRanges;
+    QVector<StatDelta> m_itemEffects;
+    QVector<QVector<int>> m_fileNodes;
+    QVector<QPair<int, int>> m_dangling;
+    QSharedPointer<StoryTextStore> m_textStore;
+    QSharedPointer<CompiledStory> m_compiled;
+    int m_deadChars = 0;
+    int m_deadChoices = 0;
+    int m_deadStats = 0;
+    int m_deadItems = 0;
+};
+
+#endif
@@ -1,137 +1,399 @@
 #include "storyloader.h"
+#include "compiledstory.h"
+#include "storystreamreader.h"
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+struct NodeRef {
+  int file;
+  int node;
+};
+
+} // namespace
+
+class StoryLoader::ParseTask : public QRunnable {
+public:
+  ParseTask(const QString &filePath, const StoryLoadOptions &options,
+            const StoryTextStore *textStore, int textSource,
+            ParsedFile *result)
+      : m_filePath(filePath), m_options(options), m_textStore(textStore),
+        m_textSource(textSource), m_result(result) {}
+
+  void run() override {
+    StoryLoader::parseFile(m_filePath, m_options, m_textStore, m_textSource,
+                           *m_result);
+  }
 
-QMap<QString, StoryNode *> StoryLoader::loadFromJson(const QString &filePath,
-                                                     QString &errorMsg) {
-  QMap<QString, StoryNode *> storyNodes;
-  errorMsg.clear();
-
-  QFile file(filePath);
-  if (!file.open(QIODevice::ReadOnly)) {
-    errorMsg = "Failed to open story file: " + filePath;
-    return storyNodes;
+private:
+  QString m_filePath;
+  StoryLoadOptions m_options;
+  const StoryTextStore *m_textStore;
+  int m_textSource;
+  ParsedFile *m_result;
+};
+
+bool LoadedStory::hasErrors() const { return !errors.isEmpty(); }
+
+QString LoadedStory::errorString() const { return errors.join("; "); }
+
+bool StoryReload::hasErrors() const { return !errors.isEmpty(); }
+
+LoadedStory StoryLoader::loadStory(const QStringList &filePaths,
+                                   const StoryLoadOptions &options) {
+  const bool compiledOnly =
+      filePaths.size() == 1 &&
+      filePaths.first().endsWith(".rsc", Qt::CaseInsensitive);
+  const QString compiledPath =
+      compiledOnly ? filePaths.first() : compiledStoryPath(filePaths);
+
+  LoadedStory story;
+  if (compiledOnly || (options.compiled && !options.pagedText &&
+                       QFileInfo(compiledPath).isFile())) {
+    story = loadCompiled(compiledPath,
+                         compiledOnly ? QStringList() : filePaths);
+    if (story.hasErrors() && !compiledOnly) {
+      qWarning() << "Ignoring compiled story:" << story.errorString();
+      story = loadFiles(filePaths, options);
+    }
+  } else {
+    story = loadFiles(filePaths, options);
   }
 
-  QByteArray data = file.readAll();
-  file.close();
+  if (!story.files.isEmpty()) {
+    const StoryFileManifest &manifest = story.files.first();
+    story.title = manifest.title;
+    story.startNodeId = manifest.startNodeId;
 
-  QJsonDocument doc = QJsonDocument::fromJson(data);
-  if (!doc.isObject()) {
-    errorMsg = "Invalid JSON format in story file";
-    return storyNodes;
+    if (manifest.error.isEmpty() && story.startNodeId.isEmpty()) {
+      story.errors.append("No 'startNode' defined in story");
+    }
   }
 
-  QJsonObject root = doc.object();
-  QJsonObject story = root["story"].toObject();
+  if (story.title.isEmpty()) {
+    story.title = "Text Adventure Game";
+  }
 
-  if (story.isEmpty()) {
-    errorMsg = "No 'story' object found in JSON file";
-    return storyNodes;
+  return story;
+}
+
+LoadedStory StoryLoader::loadCompiled(const QString &filePath,
+                                      const QStringList &sourcePaths) {
+  LoadedStory story;
+  StoryFileManifest manifest;
+  manifest.filePath = filePath;
+
+  QSharedPointer<CompiledStory> compiled(new CompiledStory);
+  if (!compiled->open(filePath, manifest.error)) {
+    story.errors.append(manifest.error);
+    story.files.append(manifest);
+    return story;
   }
 
-  QJsonArray nodesArray = story["nodes"].toArray();
-  for (const QJsonValue &nodeValue : nodesArray) {
-    QJsonObject nodeObj = nodeValue.toObject();
-    StoryNode *node = parseNode(nodeObj);
-    if (node) {
-      storyNodes[node->id()] = node;
-    }
+  if (!sourcePaths.isEmpty() && !compiled->isBuiltFrom(sourcePaths)) {
+    manifest.error = "Compiled story was built from other sources: " + filePath;
+    story.errors.append(manifest.error);
+    story.files.append(manifest);
+    return story;
+  }
+
+  story.graph.reset(new StoryGraph);
+  story.compiledPath = filePath;
+  StoryGraph &graph = *story.graph;
+  graph.loadCompiled(compiled);
+  reportUndeclaredStats(graph, 0, story.warnings);
+  reportDanglingChoices(graph, -1, story.warnings);
+
+  manifest.title = compiled->title();
+  manifest.startNodeId = compiled->startNodeId();
+  manifest.nodeCount = graph.nodeCount();
+  story.files.append(manifest);
+
+  if (graph.nodeCount() == 0) {
+    story.errors = QStringList("No valid nodes found in compiled story");
   }
 
-  if (storyNodes.isEmpty()) {
-    errorMsg = "No valid nodes found in story file";
+  return story;
+}
+
+QString StoryLoader::compiledStoryPath(const QStringList &filePaths) {
+  if (filePaths.isEmpty()) {
+    return QString();
   }
 
-  return storyNodes;
+  const QFileInfo first(filePaths.first());
+  return first.path() + "/" + first.completeBaseName() + ".rsc";
+}
+
+QStringList StoryLoader::defaultStoryFiles() {
+  return QStringList() << ":/stories/story_part1.json"
+                       << ":/stories/story_part2.json";
 }
 
-QMap<QString, StoryNode *>
+QSharedPointer<StoryGraph> StoryLoader::loadFromJson(const QString &filePath,
+                                                     QString &errorMsg) {
+  LoadedStory story = loadFiles(QStringList(filePath), StoryLoadOptions());
+  errorMsg = story.files.first().error;
+  return story.graph;
+}
+
+QSharedPointer<StoryGraph>
 StoryLoader::loadFromMultipleJson(const QStringList &filePaths,
-                                  QString &errorMsg) {
-  QMap<QString, StoryNode *> storyNodes;
-  errorMsg.clear();
+                                  QString &errorMsg,
+                                  const StoryLoadOptions &options) {
+  LoadedStory story = loadFiles(filePaths, options);
+  errorMsg = story.errorString();
+  return story.graph;
+}
 
-  for (const QString &filePath : filePaths) {
-    QString fileError;
-    QMap<QString, StoryNode *> fileNodes = loadFromJson(filePath, fileError);
+StoryReload StoryLoader::reloadFile(StoryGraph &graph, int file,
+                                    const QString &filePath,
+                                    const StoryLoadOptions &options) {
+  StoryReload reload;
 
-    if (!fileError.isEmpty()) {
-      if (!errorMsg.isEmpty()) {
-        errorMsg += "; ";
-      }
-      errorMsg += fileError;
-      continue;
-    }
+  StoryTextStore *textStore = graph.textStore();
+  if (textStore) {
+    textStore->reloadSource(file);
+  }
 
-    for (auto it = fileNodes.constBegin(); it != fileNodes.constEnd(); ++it) {
-      if (storyNodes.contains(it.key())) {
-        QString duplicateWarning =
-            QString("Duplicate node ID '%1' found in %2").arg(it.key(), filePath);
-        qWarning() << duplicateWarning;
-        if (!errorMsg.isEmpty()) {
-          errorMsg += "; ";
-        }
-        errorMsg += duplicateWarning;
-        delete it.value();
-      } else {
-        storyNodes[it.key()] = it.value();
-      }
+  ParsedFile parsedFile;
+  parseFile(filePath, options, textStore, textStore ? file : -1, parsedFile);
+  if (!parsedFile.manifest.error.isEmpty()) {
+    reload.errors.append(parsedFile.manifest.error);
+    return reload;
+  }
+
+  const int firstStat = graph.statCount();
+  for (const StatDefinition &definition : parsedFile.manifest.stats) {
+    graph.declareStat(definition);
+  }
+  for (const ItemDefinition &definition : parsedFile.manifest.items) {
+    if (graph.declareItem(definition) && definition.declared) {
+      reload.declaredItems.append(graph.symbols().items.find(definition.id));
     }
   }
 
-  if (storyNodes.isEmpty()) {
-    errorMsg = "No valid nodes found in any story files";
+  reload.diff = graph.replaceFile(*parsedFile.graph, parsedFile.nodes, file);
+  reportUndeclaredStats(graph, firstStat, reload.warnings);
+
+  for (const QString &id : qAsConst(reload.diff.duplicateIds)) {
+    QString duplicateWarning =
+        QString("Duplicate node ID '%1' found in %2").arg(id, filePath);
+    qWarning() << duplicateWarning;
+    reload.errors.append(duplicateWarning);
   }
 
-  return storyNodes;
+  reportDanglingChoices(graph, file, reload.warnings);
+  return reload;
 }
 
 QString StoryLoader::getStartNodeId(const QString &filePath,
                                     QString &errorMsg) {
   errorMsg.clear();
 
-  QFile file(filePath);
-  if (!file.open(QIODevice::ReadOnly)) {
-    errorMsg = "Failed to open story file: " + filePath;
+  QJsonObject story;
+  if (!readStoryObject(filePath, story, errorMsg)) {
     return QString();
   }
 
-  QByteArray data = file.readAll();
-  file.close();
+  QString startNode = story["startNode"].toString();
+  if (startNode.isEmpty()) {
+    errorMsg = "No 'startNode' defined in story";
+  }
 
-  QJsonDocument doc = QJsonDocument::fromJson(data);
-  if (!doc.isObject()) {
-    errorMsg = "Invalid JSON format in story file";
+  return startNode;
+}
+
+QString StoryLoader::getStoryTitle(const QString &filePath, QString &errorMsg) {
+  errorMsg.clear();
+
+  QJsonObject story;
+  if (!readStoryObject(filePath, story, errorMsg)) {
     return QString();
   }
 
-  QJsonObject root = doc.object();
-  QJsonObject story = root["story"].toObject();
+  QString title = story["title"].toString();
+  if (title.isEmpty()) {
+    title = "Text Adventure Game";
+  }
 
-  if (story.isEmpty()) {
-    errorMsg = "No 'story' object found in JSON file";
-    return QString();
+  return title;
+}
+
+LoadedStory StoryLoader::loadFiles(const QStringList &filePaths,
+                                   const StoryLoadOptions &options) {
+  LoadedStory story;
+  QVector<ParsedFile> parsedFiles(filePaths.size());
+
+  QSharedPointer<StoryTextStore> textStore;
+  QVector<int> textSources(filePaths.size(), -1);
+  if (options.pagedText) {
+    textStore.reset(new StoryTextStore(options.textCacheBytes));
+    for (int i = 0; i < filePaths.size(); ++i) {
+      textSources[i] = textStore->addSource(filePaths[i]);
+    }
   }
 
-  QString startNode = story["startNode"].toString();
-  if (startNode.isEmpty()) {
-    errorMsg = "No 'startNode' defined in story";
+  int threadCount = options.threadCount > 0 ? options.threadCount
+                                            : QThread::idealThreadCount();
+  threadCount = qMin(threadCount, filePaths.size());
+
+  if (threadCount > 1) {
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    for (int i = 0; i < filePaths.size(); ++i) {
+      pool.start(new ParseTask(filePaths[i], options, textStore.data(),
+                               textSources[i], &parsedFiles[i]));
+    }
+    pool.waitForDone();
+  } else {
+    for (int i = 0; i < filePaths.size(); ++i) {
+      parseFile(filePaths[i], options, textStore.data(), textSources[i],
+                parsedFiles[i]);
+    }
   }
 
-  return startNode;
+  mergeFiles(story, parsedFiles);
+  story.graph->setTextStore(textStore);
+
+  if (story.graph->nodeCount() == 0) {
+    story.errors = QStringList("No valid nodes found in any story files");
+  }
+
+  return story;
 }
 
-QString StoryLoader::getStoryTitle(const QString &filePath, QString &errorMsg) {
-  errorMsg.clear();
+void StoryLoader::mergeFiles(LoadedStory &story,
+                             const QVector<ParsedFile> &parsedFiles) {
+  story.graph.reset(new StoryGraph);
+
+  QVector<int> stringBases(parsedFiles.size(), 0);
+  QVector<NodeRef> nodes;
+  for (int file = 0; file < parsedFiles.size(); ++file) {
+    const ParsedFile &parsedFile = parsedFiles[file];
+    story.files.append(parsedFile.manifest);
+
+    if (!parsedFile.manifest.error.isEmpty()) {
+      story.errors.append(parsedFile.manifest.error);
+      continue;
+    }
+
+    declareSchema(*story.graph, parsedFile.manifest, story.warnings);
+    stringBases[file] = story.graph->appendStrings(*parsedFile.graph);
+    for (int node : parsedFile.nodes) {
+      nodes.append({file, node});
+    }
+  }
+
+  auto nodeId = [&parsedFiles](const NodeRef &ref) {
+    return parsedFiles[ref.file].graph->nodeId(ref.node);
+  };
+  std::stable_sort(nodes.begin(), nodes.end(),
+                   [&nodeId](const NodeRef &a, const NodeRef &b) {
+                     return nodeId(a) < nodeId(b);
+                   });
+
+  QVector<NodeRef> duplicates;
+  for (int i = 0; i < nodes.size(); ++i) {
+    const NodeRef &ref = nodes[i];
+    if (i > 0 && nodeId(nodes[i - 1]) == nodeId(ref)) {
+      duplicates.append(ref);
+    } else {
+      story.graph->appendNode(*parsedFiles[ref.file].graph, ref.node,
+                              stringBases[ref.file], ref.file);
+    }
+  }
+
+  std::sort(duplicates.begin(), duplicates.end(),
+            [&nodeId](const NodeRef &a, const NodeRef &b) {
+              return a.file != b.file ? a.file < b.file : nodeId(a) < nodeId(b);
+            });
+  for (const NodeRef &ref : qAsConst(duplicates)) {
+    QString duplicateWarning =
+        QString("Duplicate node ID '%1' found in %2")
+            .arg(nodeId(ref).toString(),
+                 parsedFiles[ref.file].manifest.filePath);
+    qWarning() << duplicateWarning;
+    story.errors.append(duplicateWarning);
+  }
+
+  story.graph->internSymbols();
+  reportUndeclaredStats(*story.graph, 0, story.warnings);
+
+  story.graph->linkChoices();
+  reportDanglingChoices(*story.graph, -1, story.warnings);
+}
+
+void StoryLoader::declareSchema(StoryGraph &graph,
+                                const StoryFileManifest &manifest,
+                                QStringList &warnings) {
+  for (const StatDefinition &definition : manifest.stats) {
+    if (!graph.declareStat(definition)) {
+      QString statWarning = QString("Stat '%1' declared again in %2")
+                                .arg(definition.id, manifest.filePath);
+      qWarning() << statWarning;
+      warnings.append(statWarning);
+    }
+  }
+
+  for (const ItemDefinition &definition : manifest.items) {
+    if (!graph.declareItem(definition)) {
+      QString itemWarning = QString("Item '%1' declared again in %2")
+                                .arg(definition.id, manifest.filePath);
+      qWarning() << itemWarning;
+      warnings.append(itemWarning);
+    }
+  }
+}
+
+void StoryLoader::reportUndeclaredStats(const StoryGraph &graph, int firstStat,
+                                        QStringList &warnings) {
+  for (int stat = firstStat; stat < graph.statCount(); ++stat) {
+    const StatDefinition &definition = graph.statDefinition(stat);
+    if (!definition.declared) {
+      QString statWarning =
+          QString("Stat '%1' is not declared in the story schema")
+              .arg(definition.id);
+      qWarning() << statWarning;
+      warnings.append(statWarning);
+    }
+  }
+}
+
+void StoryLoader::reportDanglingChoices(const StoryGraph &graph, int file,
+                                        QStringList &warnings) {
+  for (const QPair<int, int> &link : graph.danglingChoices()) {
+    if (file >= 0 && graph.nodeFile(link.first) != file) {
+      continue;
+    }
+
+    const StoryNode &node = graph.node(link.first);
+    QString danglingWarning =
+        QString("Choice %1 of node '%2' targets missing node '%3'")
+            .arg(link.second)
+            .arg(node.id(), node.choice(link.second).targetNodeId());
+    qWarning() << danglingWarning;
+    warnings.append(danglingWarning);
+  }
+}
 
+bool StoryLoader::readStoryObject(const QString &filePath, QJsonObject &story,
+                                  QString &errorMsg) {
   QFile file(filePath);
   if (!file.open(QIODevice::ReadOnly)) {
     errorMsg = "Failed to open story file: " + filePath;
-    return QString();
+    return false;
   }
 
   QByteArray data = file.readAll();
@@ -140,72 +402,166 @@ QString StoryLoader::getStoryTitle(const QString &filePath, QString &errorMsg) {
   QJsonDocument doc = QJsonDocument::fromJson(data);
   if (!doc.isObject()) {
     errorMsg = "Invalid JSON format in story file";
-    return QString();
+    return false;
   }
 
   QJsonObject root = doc.object();
-  QJsonObject story = root["story"].toObject();
+  story = root["story"].toObject();
 
   if (story.isEmpty()) {
     errorMsg = "No 'story' object found in JSON file";
-    return QString();
+    return false;
   }
 
-  QString title = story["title"].toString();
-  if (title.isEmpty()) {
-    title = "Text Adventure Game";
+  return true;
+}
+
+void StoryLoader::parseFile(const QString &filePath,
+                            const StoryLoadOptions &options,
+                            const StoryTextStore *textStore, int textSource,
+                            ParsedFile &result) {
+  StoryFileManifest &manifest = result.manifest;
+  manifest.filePath = filePath;
+  result.graph.reset(new StoryGraph);
+  StoryGraph &graph = *result.graph;
+
+  if (options.streaming || textStore) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+      manifest.error = "Failed to open story file: " + filePath;
+      return;
+    }
+
+    StoryStreamReader reader(&file);
+    reader.setTextStore(textStore, textSource);
+    reader.read(graph, manifest);
+    if (!manifest.error.isEmpty()) {
+      return;
+    }
+  } else {
+    QJsonObject story;
+    if (!readStoryObject(filePath, story, manifest.error)) {
+      return;
+    }
+
+    manifest.title = story["title"].toString();
+    manifest.startNodeId = story["startNode"].toString();
+    parseStats(story["stats"].toArray(), manifest.stats);
+    parseItems(story["items"].toArray(), manifest.items);
+
+    QJsonArray nodesArray = story["nodes"].toArray();
+    for (const QJsonValue &nodeValue : nodesArray) {
+      QJsonObject nodeObj = nodeValue.toObject();
+      parseNode(graph, nodeObj);
+    }
   }
 
-  return title;
+  QVector<int> nodes(graph.nodeCount());
+  std::iota(nodes.begin(), nodes.end(), 0);
+  std::stable_sort(nodes.begin(), nodes.end(), [&graph](int a, int b) {
+    return graph.nodeId(a) < graph.nodeId(b);
+  });
+
+  result.nodes.clear();
+  for (int i = 0; i < nodes.size(); ++i) {
+    if (i + 1 < nodes.size() &&
+        graph.nodeId(nodes[i]) == graph.nodeId(nodes[i + 1])) {
+      continue;
+    }
+    result.nodes.append(nodes[i]);
+  }
+
+  manifest.nodeCount = result.nodes.size();
+  if (result.nodes.isEmpty()) {
+    manifest.error = "No valid nodes found in story file";
+  }
+}
+
+void StoryLoader::parseStats(const QJsonArray &statsArray,
+                             QVector<StatDefinition> &stats) {
+  stats.clear();
+  for (const QJsonValue &statValue : statsArray) {
+    QJsonObject statObj = statValue.toObject();
+    StatDefinition definition;
+    definition.id = statObj["id"].toString();
+    definition.name = statObj["name"].toString();
+    definition.initial = statObj["initial"].toInt();
+    definition.minimum = statObj.value("min").toInt(definition.minimum);
+    definition.maximum = statObj.value("max").toInt(definition.maximum);
+
+    if (definition.id.isEmpty()) {
+      qWarning() << "Invalid stat: missing id";
+      continue;
+    }
+    stats.append(definition);
+  }
 }
 
-StoryNode *StoryLoader::parseNode(const QJsonObject &nodeObj) {
+void StoryLoader::parseItems(const QJsonArray &itemsArray,
+                             QVector<ItemDefinition> &items) {
+  items.clear();
+  for (const QJsonValue &itemValue : itemsArray) {
+    QJsonObject itemObj = itemValue.toObject();
+    ItemDefinition definition;
+    definition.id = itemObj["id"].toString();
+
+    if (definition.id.isEmpty()) {
+      qWarning() << "Invalid item: missing id";
+      continue;
+    }
+
+    QJsonObject effectsObj = itemObj["effects"].toObject();
+    for (auto it = effectsObj.constBegin(); it != effectsObj.constEnd(); ++it) {
+      definition.effects.append({it.key(), it.value().toInt()});
+    }
+    items.append(definition);
+  }
+}
+
+void StoryLoader::parseNode(StoryGraph &graph, const QJsonObject &nodeObj) {
   QString id = nodeObj["id"].toString();
   QString text = nodeObj["text"].toString();
 
   if (id.isEmpty() || text.isEmpty()) {
     qWarning() << "Invalid node: missing id or text";
-    return nullptr;
+    return;
   }
 
-  StoryNode *node = new StoryNode(id, text);
+  const StoryGraph::Mark nodeStart = graph.mark();
 
   QJsonArray choicesArray = nodeObj["choices"].toArray();
   for (const QJsonValue &choiceValue : choicesArray) {
     QJsonObject choiceObj = choiceValue.toObject();
-    Choice *choice = parseChoice(choiceObj);
-    if (choice) {
-      node->addChoice(choice);
-    }
+    parseChoice(graph, choiceObj);
   }
 
-  return node;
+  graph.addNode(nodeStart, id, text);
 }
 
-Choice *StoryLoader::parseChoice(const QJsonObject &choiceObj) {
+void StoryLoader::parseChoice(StoryGraph &graph, const QJsonObject &choiceObj) {
   QString text = choiceObj["text"].toString();
   QString target = choiceObj["target"].toString();
 
   if (text.isEmpty() || target.isEmpty()) {
     qWarning() << "Invalid choice: missing text or target";
-    return nullptr;
+    return;
   }
 
-  QMap<QString, int> statChanges;
+  const StoryGraph::Mark choiceStart = graph.mark();
+
   if (choiceObj.contains("stats")) {
     QJsonObject statsObj = choiceObj["stats"].toObject();
     for (auto it = statsObj.constBegin(); it != statsObj.constEnd(); ++it) {
-      statChanges[it.key()] = it.value().toInt();
+      graph.addStat(choiceStart, it.key(), it.value().toInt());
     }
   }
 
-  QStringList itemsGained;
   if (choiceObj.contains("items")) {
     QJsonArray itemsArray = choiceObj["items"].toArray();
     for (const QJsonValue &itemValue : itemsArray) {
-      itemsGained.append(itemValue.toString());
+      graph.addItem(itemValue.toString());
     }
   }
 
-  return new Choice(text, target, statChanges, itemsGained);
+  graph.addChoice(choiceStart, text, target);
 }
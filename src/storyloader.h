@@ -2,23 +2,95 @@
 #define STORYLOADER_H
 
 #include <QString>
-#include <QMap>
+#include <QStringList>
+#include <QList>
+#include <QVector>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
-#include "storynode.h"
+#include <QSharedPointer>
+#include "storygraph.h"
+
+struct StoryFileManifest {
+    QString filePath;
+    QString title;
+    QString startNodeId;
+    QVector<StatDefinition> stats;
+    QVector<ItemDefinition> items;
+    int nodeCount = 0;
+    QString error;
+};
+
+struct LoadedStory {
+    QString title;
+    QString startNodeId;
+    QSharedPointer<StoryGraph> graph;
+    QString compiledPath;
+    QList<StoryFileManifest> files;
+    QStringList errors;
+    QStringList warnings;
+
+    bool hasErrors() const;
+    QString errorString() const;
+};
+
+struct StoryReload {
+    StoryGraph::FileDiff diff;
+    QVector<int> declaredItems;
+    QVector<int> movedTransitions;
+    QStringList errors;
+    QStringList warnings;
+
+    bool hasErrors() const;
+};
+
+struct StoryLoadOptions {
+    int threadCount = 1;
+    bool streaming = false;
+    bool pagedText = false;
+    bool compiled = true;
+    int textCacheBytes = StoryTextStore::DefaultCacheBytes;
+};
 
 class StoryLoader
 {
 public:
-    static QMap<QString, StoryNode*> loadFromJson(const QString &filePath, QString &errorMsg);
-    static QMap<QString, StoryNode*> loadFromMultipleJson(const QStringList &filePaths, QString &errorMsg);
+    static LoadedStory loadStory(const QStringList &filePaths,
+                                 const StoryLoadOptions &options = StoryLoadOptions());
+    static LoadedStory loadCompiled(const QString &filePath,
+                                    const QStringList &sourcePaths = QStringList());
+    static QString compiledStoryPath(const QStringList &filePaths);
+    static QStringList defaultStoryFiles();
+
+    static QSharedPointer<StoryGraph> loadFromJson(const QString &filePath, QString &errorMsg);
+    static QSharedPointer<StoryGraph> loadFromMultipleJson(const QStringList &filePaths, QString &errorMsg,
+                                                           const StoryLoadOptions &options = StoryLoadOptions());
+    static StoryReload reloadFile(StoryGraph &graph, int file, const QString &filePath,
+                                  const StoryLoadOptions &options = StoryLoadOptions());
     static QString getStartNodeId(const QString &filePath, QString &errorMsg);
     static QString getStoryTitle(const QString &filePath, QString &errorMsg);
 
 private:
-    static StoryNode* parseNode(const QJsonObject &nodeObj);
-    static Choice* parseChoice(const QJsonObject &choiceObj);
+    struct ParsedFile {
+        StoryFileManifest manifest;
+        QSharedPointer<StoryGraph> graph;
+        QVector<int> nodes;
+    };
+    class ParseTask;
+
+    static LoadedStory loadFiles(const QStringList &filePaths, const StoryLoadOptions &options);
+    static void mergeFiles(LoadedStory &story, const QVector<ParsedFile> &parsedFiles);
+    static void declareSchema(StoryGraph &graph, const StoryFileManifest &manifest,
+                              QStringList &warnings);
+    static void reportUndeclaredStats(const StoryGraph &graph, int firstStat, QStringList &warnings);
+    static void reportDanglingChoices(const StoryGraph &graph, int file, QStringList &warnings);
+    static bool readStoryObject(const QString &filePath, QJsonObject &story, QString &errorMsg);
+    static void parseFile(const QString &filePath, const StoryLoadOptions &options,
+                          const StoryTextStore *textStore, int textSource, ParsedFile &result);
+    static void parseStats(const QJsonArray &statsArray, QVector<StatDefinition> &stats);
+    static void parseItems(const QJsonArray &itemsArray, QVector<ItemDefinition> &items);
+    static void parseNode(StoryGraph &graph, const QJsonObject &nodeObj);
+    static void parseChoice(StoryGraph &graph, const QJsonObject &choiceObj);
 };
 
 #endif
@@ -1,44 +1,40 @@
 #include "storynode.h"
+#include "storygraph.h"
 
-StoryNode::StoryNode(const QString &id, const QString &text)
-    : m_id(id), m_text(text)
-{
-}
-
-StoryNode::~StoryNode()
+QString StoryNode::id() const
 {
-    qDeleteAll(m_choices);
-    m_choices.clear();
+    return m_graph->string(m_id);
 }
 
-QString StoryNode::id() const
+int StoryNode::symbol() const
 {
-    return m_id;
+    return m_symbol;
 }
 
 QString StoryNode::text() const
 {
-    return m_text;
+    if (m_textSource >= 0) {
+        return m_graph->textStore()->text(m_textSource, m_textOffset, m_text.length);
+    }
+    return m_graph->string(m_text);
 }
 
-QList<Choice*> StoryNode::choices() const
+int StoryNode::choiceCount() const
 {
-    return m_choices;
+    return m_choiceCount;
 }
 
-bool StoryNode::isEndNode() const
+const Choice &StoryNode::choice(int index) const
 {
-    return m_choices.isEmpty();
+    return m_graph->m_choices[m_firstChoice + index];
 }
 
-void StoryNode::addChoice(Choice *choice)
+bool StoryNode::isEndNode() const
 {
-    if (choice) {
-        m_choices.append(choice);
-    }
+    return m_choiceCount == 0 && !m_removed;
 }
 
-void StoryNode::setText(const QString &text)
+bool StoryNode::isRemoved() const
 {
-    m_text = text;
+    return m_removed;
 }
@@ -2,27 +2,37 @@
 #define STORYNODE_H
 
 #include <QString>
-#include <QList>
 #include "choice.h"
 
 class StoryNode
 {
 public:
-    StoryNode(const QString &id, const QString &text);
-    ~StoryNode();
+    StoryNode() = default;
 
     QString id() const;
+    int symbol() const;
     QString text() const;
-    QList<Choice*> choices() const;
+    int choiceCount() const;
+    const Choice &choice(int index) const;
     bool isEndNode() const;
-
-    void addChoice(Choice *choice);
-    void setText(const QString &text);
+    bool isRemoved() const;
 
 private:
-    QString m_id;
-    QString m_text;
-    QList<Choice*> m_choices;
+    friend class StoryGraph;
+
+    const StoryGraph *m_graph = nullptr;
+    StoryStringRef m_id;
+    StoryStringRef m_text;
+    int m_symbol = -1;
+    int m_firstChoice = 0;
+    int m_choiceCount = 0;
+    int m_file = -1;
+    bool m_removed = false;
+
+    int m_textSource = -1;
+    qint64 m_textOffset = 0;
 };
 
+Q_DECLARE_TYPEINFO(StoryNode, Q_PRIMITIVE_TYPE);
+
 #endif
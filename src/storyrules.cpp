@@ -0,0 +1,165 @@
+#include "storyrules.h"
+
+StoryRules::StoryRules(const StoryGraph &graph) : m_graph(graph) {
+  m_firstTransition.reserve(graph.nodeCount());
+  m_transitionCounts.reserve(graph.nodeCount());
+  m_transitions.reserve(graph.choiceCount());
+  for (int node = 0; node < graph.nodeCount(); ++node) {
+    const StoryNode &storyNode = graph.node(node);
+    m_firstTransition.append(m_transitions.size());
+    m_transitionCounts.append(storyNode.choiceCount());
+    for (int i = 0; i < storyNode.choiceCount(); ++i) {
+      m_transitions.append(buildTransition(storyNode.choice(i)));
+    }
+  }
+}
+
+StoryRules::StoryRules(const StoryRules &other, const StoryGraph &graph)
+    : m_graph(graph), m_firstTransition(other.m_firstTransition),
+      m_transitionCounts(other.m_transitionCounts),
+      m_transitions(other.m_transitions), m_ops(other.m_ops),
+      m_items(other.m_items), m_deadTransitions(other.m_deadTransitions),
+      m_deadOps(other.m_deadOps),
+      m_deadItems(other.m_deadItems), m_packed(other.m_packed) {}
+
+const StoryGraph &StoryRules::graph() const { return m_graph; }
+
+int StoryRules::statCount() const { return m_graph.statCount(); }
+
+QVector<int> StoryRules::initialStats() const {
+  QVector<int> stats;
+  stats.reserve(m_graph.statCount());
+  for (int stat = 0; stat < m_graph.statCount(); ++stat) {
+    stats.append(m_graph.statDefinition(stat).initial);
+  }
+  return stats;
+}
+
+int StoryRules::firstTransition(int node) const {
+  return m_firstTransition[node];
+}
+
+int StoryRules::transitionCount(int node) const {
+  return m_transitionCounts[node];
+}
+
+int StoryRules::totalTransitions() const { return m_transitions.size(); }
+
+bool StoryRules::isPacked() const { return m_packed; }
+
+const StoryRules::Transition &StoryRules::transition(int index) const {
+  return m_transitions[index];
+}
+
+int StoryRules::item(int index) const { return m_items[index]; }
+
+void StoryRules::applyStats(const Transition &transition, int *stats) const {
+  const StatDelta *op = m_ops.constData() + transition.firstOp;
+  const StatDelta *end = op + transition.opCount;
+  for (; op != end; ++op) {
+    if (op->stat >= 0) {
+      stats[op->stat] = m_graph.adjustedStat(op->stat, stats[op->stat],
+                                             op->delta);
+    }
+  }
+}
+
+QVector<int> StoryRules::update(const QVector<int> &nodes) {
+  while (m_firstTransition.size() < m_graph.nodeCount()) {
+    m_firstTransition.append(m_transitions.size());
+    m_transitionCounts.append(0);
+  }
+
+  for (int node : nodes) {
+    const int first = m_firstTransition[node];
+    for (int i = 0; i < m_transitionCounts[node]; ++i) {
+      m_deadOps += m_transitions[first + i].opCount;
+      m_deadItems += m_transitions[first + i].itemCount;
+    }
+
+    const StoryNode &storyNode = m_graph.node(node);
+    const int count = storyNode.choiceCount();
+    if (count != m_transitionCounts[node]) {
+      m_packed = false;
+    }
+    if (count > m_transitionCounts[node]) {
+      m_deadTransitions += m_transitionCounts[node];
+      m_firstTransition[node] = m_transitions.size();
+      m_transitions.resize(m_transitions.size() + count);
+    } else {
+      m_deadTransitions += m_transitionCounts[node] - count;
+    }
+    m_transitionCounts[node] = count;
+
+    for (int i = 0; i < count; ++i) {
+      m_transitions[m_firstTransition[node] + i] =
+          buildTransition(storyNode.choice(i));
+    }
+  }
+
+  if (m_deadTransitions * 2 > m_transitions.size() ||
+      m_deadOps * 2 > m_ops.size() || m_deadItems * 2 > m_items.size()) {
+    return compact();
+  }
+  return QVector<int>();
+}
+
+StoryRules::Transition StoryRules::buildTransition(const Choice &choice) {
+  const ConstSpan<int> items = choice.itemSymbols();
+
+  Transition transition;
+  transition.target = choice.targetNode();
+  transition.firstOp = m_ops.size();
+  for (const StatDelta &delta : choice.statDeltas()) {
+    m_ops.append(delta);
+  }
+  for (int item : items) {
+    for (const StatDelta &effect : m_graph.itemEffects(item)) {
+      m_ops.append(effect);
+    }
+  }
+  transition.opCount = m_ops.size() - transition.firstOp;
+  transition.firstItem = m_items.size();
+  transition.itemCount = items.size();
+  for (int item : items) {
+    m_items.append(item);
+  }
+  return transition;
+}
+
+QVector<int> StoryRules::compact() {
+  QVector<int> ordinals(m_transitions.size(), -1);
+  QVector<Transition> transitions;
+  QVector<StatDelta> ops;
+  QVector<int> items;
+  transitions.reserve(m_transitions.size() - m_deadTransitions);
+  ops.reserve(m_ops.size() - m_deadOps);
+  items.reserve(m_items.size() - m_deadItems);
+
+  for (int node = 0; node < m_firstTransition.size(); ++node) {
+    const int first = m_firstTransition[node];
+    m_firstTransition[node] = transitions.size();
+    for (int i = 0; i < m_transitionCounts[node]; ++i) {
+      Transition transition = m_transitions[first + i];
+      const int firstOp = ops.size();
+      ops += m_ops.mid(transition.firstOp, transition.opCount);
+      transition.firstOp = firstOp;
+
+      const int firstItem = items.size();
+      items += m_items.mid(transition.firstItem, transition.itemCount);
+      transition.firstItem = firstItem;
+
+      ordinals[first + i] = transitions.size();
+      transitions.append(transition);
+    }
+  }
+
+  m_transitions.swap(transitions);
+  m_ops.swap(ops);
+  m_items.swap(items);
+  m_deadTransitions = 0;
+  m_deadOps = 0;
+  m_deadItems = 0;
+  m_packed = true;
+  return ordinals;
+}
@@ -0,0 +1,53 @@
+#ifndef STORYRULES_H
+#define STORYRULES_H
+
+#include <QVector>
+#include "storygraph.h"
+
+class StoryRules
+{
+public:
+    struct Transition {
+        int target = -1;
+        int firstOp = 0;
+        int opCount = 0;
+        int firstItem = 0;
+        int itemCount = 0;
+    };
+
+    explicit StoryRules(const StoryGraph &graph);
+    StoryRules(const StoryRules &other, const StoryGraph &graph);
+
+    const StoryGraph &graph() const;
+    int statCount() const;
+    QVector<int> initialStats() const;
+
+    int firstTransition(int node) const;
+    int transitionCount(int node) const;
+    int totalTransitions() const;
+    bool isPacked() const;
+    const Transition &transition(int index) const;
+    int item(int index) const;
+
+    void applyStats(const Transition &transition, int *stats) const;
+    QVector<int> update(const QVector<int> &nodes);
+
+private:
+    Transition buildTransition(const Choice &choice);
+    QVector<int> compact();
+
+    const StoryGraph &m_graph;
+    QVector<int> m_firstTransition;
+    QVector<int> m_transitionCounts;
+    QVector<Transition> m_transitions;
+    QVector<StatDelta> m_ops;
+    QVector<int> m_items;
+    int m_deadTransitions = 0;
+    int m_deadOps = 0;
+    int m_deadItems = 0;
+    bool m_packed = true;
+};
+
+Q_DECLARE_TYPEINFO(StoryRules::Transition, Q_PRIMITIVE_TYPE);
+
+#endif
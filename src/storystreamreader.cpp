@@ -0,0 +1,730 @@
+#include "storystreamreader.h"
+#include "storygraph.h"
+#include "storyloader.h"
+#include <QBuffer>
+#include <QDebug>
+#include <limits>
+
+namespace {
+
+const int ChunkSize = 64 * 1024;
+const int MaxDepth = 512;
+
+bool isDigit(int c) { return c >= '0' && c <= '9'; }
+
+bool isValidNumber(const QByteArray &number) {
+  const char *p = number.constData();
+  const char *end = p + number.size();
+
+  if (p < end && *p == '-') {
+    ++p;
+  }
+  if (p == end) {
+    return false;
+  }
+  if (*p == '0') {
+    ++p;
+  } else if (isDigit(*p)) {
+    while (p < end && isDigit(*p)) {
+      ++p;
+    }
+  } else {
+    return false;
+  }
+
+  if (p < end && *p == '.') {
+    ++p;
+    if (p == end || !isDigit(*p)) {
+      return false;
+    }
+    while (p < end && isDigit(*p)) {
+      ++p;
+    }
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    if (p < end && (*p == '+' || *p == '-')) {
+      ++p;
+    }
+    if (p == end || !isDigit(*p)) {
+      return false;
+    }
+    while (p < end && isDigit(*p)) {
+      ++p;
+    }
+  }
+
+  return p == end;
+}
+
+void appendUtf8(QByteArray &out, uint code) {
+  if (code < 0x80) {
+    out.append(char(code));
+  } else if (code < 0x800) {
+    out.append(char(0xc0 | (code >> 6)));
+    out.append(char(0x80 | (code & 0x3f)));
+  } else if (code < 0x10000) {
+    out.append(char(0xe0 | (code >> 12)));
+    out.append(char(0x80 | ((code >> 6) & 0x3f)));
+    out.append(char(0x80 | (code & 0x3f)));
+  } else {
+    out.append(char(0xf0 | (code >> 18)));
+    out.append(char(0x80 | ((code >> 12) & 0x3f)));
+    out.append(char(0x80 | ((code >> 6) & 0x3f)));
+    out.append(char(0x80 | (code & 0x3f)));
+  }
+}
+
+} // namespace
+
+template <typename Member>
+bool StoryStreamReader::readObject(Member member) {
+  if (!consume('{')) {
+    return false;
+  }
+  if (skipWhitespace() == '}') {
+    ++m_pos;
+    return true;
+  }
+
+  QByteArray key;
+  for (;;) {
+    if (!readRawString(&key) || !consume(':') || !member(key)) {
+      return false;
+    }
+
+    const int c = skipWhitespace();
+    ++m_pos;
+    if (c == '}') {
+      return true;
+    }
+    if (c != ',') {
+      return false;
+    }
+  }
+}
+
+template <typename Element>
+bool StoryStreamReader::readArray(Element element) {
+  if (!consume('[')) {
+    return false;
+  }
+  if (skipWhitespace() == ']') {
+    ++m_pos;
+    return true;
+  }
+
+  for (;;) {
+    if (!element()) {
+      return false;
+    }
+
+    const int c = skipWhitespace();
+    ++m_pos;
+    if (c == ']') {
+      return true;
+    }
+    if (c != ',') {
+      return false;
+    }
+  }
+}
+
+StoryStreamReader::StoryStreamReader(QIODevice *device)
+    : m_device(device), m_bufferOffset(device->pos()), m_size(0), m_pos(0),
+      m_graph(nullptr), m_textStore(nullptr), m_textSource(-1) {}
+
+void StoryStreamReader::setTextStore(const StoryTextStore *textStore,
+                                     int textSource) {
+  m_textStore = textStore;
+  m_textSource = textSource;
+}
+
+void StoryStreamReader::read(StoryGraph &graph, StoryFileManifest &manifest) {
+  m_graph = &graph;
+  bool hasStory = false;
+  bool storyIsEmpty = true;
+
+  bool ok = readObject([&](const QByteArray &key) {
+    if (key != "story") {
+      return skipValue();
+    }
+    hasStory = true;
+    return readStory(manifest, storyIsEmpty);
+  });
+
+  if (ok && skipWhitespace() != -1) {
+    ok = false;
+  }
+
+  if (!ok) {
+    graph.clear();
+    manifest.error = "Invalid JSON format in story file";
+  } else if (!hasStory || storyIsEmpty) {
+    graph.clear();
+    manifest.error = "No 'story' object found in JSON file";
+  }
+
+  m_graph = nullptr;
+}
+
+bool StoryStreamReader::decodeString(const QByteArray &json, QString &value) {
+  QBuffer buffer;
+  buffer.setData(json);
+  if (!buffer.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  StoryStreamReader reader(&buffer);
+  return reader.readString(value) && reader.skipWhitespace() == -1;
+}
+
+bool StoryStreamReader::fill() {
+  m_bufferOffset += m_size;
+  if (m_buffer.size() != ChunkSize) {
+    m_buffer.resize(ChunkSize);
+  }
+
+  const qint64 bytesRead = m_device->read(m_buffer.data(), ChunkSize);
+  m_size = bytesRead > 0 ? static_cast<int>(bytesRead) : 0;
+  m_pos = 0;
+  return m_size > 0;
+}
+
+qint64 StoryStreamReader::position() const { return m_bufferOffset + m_pos; }
+
+int StoryStreamReader::peekChar() {
+  if (m_pos >= m_size && !fill()) {
+    return -1;
+  }
+  return static_cast<uchar>(m_buffer.at(m_pos));
+}
+
+int StoryStreamReader::skipWhitespace() {
+  for (;;) {
+    const int c = peekChar();
+    if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+      return c;
+    }
+    ++m_pos;
+  }
+}
+
+bool StoryStreamReader::consume(char expected) {
+  if (skipWhitespace() != expected) {
+    return false;
+  }
+  ++m_pos;
+  return true;
+}
+
+bool StoryStreamReader::readRawString(QByteArray *value) {
+  if (!consume('"')) {
+    return false;
+  }
+  if (value) {
+    value->clear();
+  }
+
+  for (;;) {
+    if (m_pos >= m_size && !fill()) {
+      return false;
+    }
+
+    const char *begin = m_buffer.constData() + m_pos;
+    const char *end = m_buffer.constData() + m_size;
+    const char *p = begin;
+    while (p < end && *p != '"' && *p != '\\' && uchar(*p) >= 0x20) {
+      ++p;
+    }
+
+    if (value) {
+      value->append(begin, static_cast<int>(p - begin));
+    }
+    m_pos += static_cast<int>(p - begin);
+    if (p == end) {
+      continue;
+    }
+
+    const char c = *p;
+    ++m_pos;
+    if (c == '"') {
+      return true;
+    }
+    if (c != '\\') {
+      return false;
+    }
+
+    const int escape = peekChar();
+    ++m_pos;
+    char decoded = 0;
+    switch (escape) {
+    case '"':
+    case '\\':
+    case '/':
+      decoded = char(escape);
+      break;
+    case 'b':
+      decoded = '\b';
+      break;
+    case 'f':
+      decoded = '\f';
+      break;
+    case 'n':
+      decoded = '\n';
+      break;
+    case 'r':
+      decoded = '\r';
+      break;
+    case 't':
+      decoded = '\t';
+      break;
+    case 'u': {
+      uint code = 0;
+      if (!readHex4(code)) {
+        return false;
+      }
+      if (code >= 0xd800 && code < 0xdc00) {
+        uint low = 0;
+        if (peekChar() != '\\') {
+          return false;
+        }
+        ++m_pos;
+        if (peekChar() != 'u') {
+          return false;
+        }
+        ++m_pos;
+        if (!readHex4(low) || low < 0xdc00 || low >= 0xe000) {
+          return false;
+        }
+        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+      } else if (code >= 0xdc00 && code < 0xe000) {
+        code = 0xfffd;
+      }
+      if (value) {
+        appendUtf8(*value, code);
+      }
+      continue;
+    }
+    default:
+      return false;
+    }
+
+    if (value) {
+      value->append(decoded);
+    }
+  }
+}
+
+bool StoryStreamReader::readString(QString &value) {
+  if (!readRawString(&m_scratch)) {
+    return false;
+  }
+  value = QString::fromUtf8(m_scratch);
+  return true;
+}
+
+bool StoryStreamReader::readNumber(double *value) {
+  m_number.clear();
+  for (;;) {
+    const int c = peekChar();
+    if (!isDigit(c) && c != '-' && c != '+' && c != '.' && c != 'e' &&
+        c != 'E') {
+      break;
+    }
+    m_number.append(char(c));
+    ++m_pos;
+  }
+
+  if (!isValidNumber(m_number)) {
+    return false;
+  }
+
+  if (value) {
+    bool ok = false;
+    *value = m_number.toDouble(&ok);
+    return ok;
+  }
+  return true;
+}
+
+bool StoryStreamReader::readLiteral(const char *literal) {
+  for (const char *p = literal; *p; ++p) {
+    if (peekChar() != uchar(*p)) {
+      return false;
+    }
+    ++m_pos;
+  }
+  return true;
+}
+
+bool StoryStreamReader::readHex4(uint &value) {
+  value = 0;
+  for (int i = 0; i < 4; ++i) {
+    const int c = peekChar();
+    ++m_pos;
+    value <<= 4;
+    if (isDigit(c)) {
+      value |= uint(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      value |= uint(c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+      value |= uint(c - 'A' + 10);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool StoryStreamReader::skipValue(int depth) {
+  if (depth > MaxDepth) {
+    return false;
+  }
+
+  switch (skipWhitespace()) {
+  case '{':
+    return readObject(
+        [&](const QByteArray &) { return skipValue(depth + 1); });
+  case '[':
+    return readArray([&]() { return skipValue(depth + 1); });
+  case '"':
+    return readRawString(nullptr);
+  case 't':
+    return readLiteral("true");
+  case 'f':
+    return readLiteral("false");
+  case 'n':
+    return readLiteral("null");
+  default:
+    return readNumber(nullptr);
+  }
+}
+
+bool StoryStreamReader::readStringValue(QString &value) {
+  if (skipWhitespace() == '"') {
+    return readString(value);
+  }
+  value.clear();
+  return skipValue();
+}
+
+bool StoryStreamReader::readIntValue(int &value) {
+  const int c = skipWhitespace();
+  if (c != '-' && !isDigit(c)) {
+    value = 0;
+    return skipValue();
+  }
+
+  double number = 0.0;
+  if (!readNumber(&number)) {
+    return false;
+  }
+  value = number >= std::numeric_limits<int>::min() &&
+                  number <= std::numeric_limits<int>::max() &&
+                  int(number) == number
+              ? int(number)
+              : 0;
+  return true;
+}
+
+bool StoryStreamReader::readStory(StoryFileManifest &manifest,
+                                  bool &isEmpty) {
+  manifest.title.clear();
+  manifest.startNodeId.clear();
+  manifest.stats.clear();
+  manifest.items.clear();
+  m_graph->clear();
+  isEmpty = true;
+
+  if (skipWhitespace() != '{') {
+    return skipValue();
+  }
+
+  return readObject([&](const QByteArray &key) {
+    isEmpty = false;
+    if (key == "title") {
+      return readStringValue(manifest.title);
+    }
+    if (key == "startNode") {
+      return readStringValue(manifest.startNodeId);
+    }
+    if (key == "stats") {
+      return readStatDefinitions(manifest.stats);
+    }
+    if (key == "items") {
+      return readItemDefinitions(manifest.items);
+    }
+    if (key == "nodes") {
+      m_graph->clear();
+      if (skipWhitespace() != '[') {
+        return skipValue();
+      }
+      return readNodes();
+    }
+    return skipValue();
+  });
+}
+
+bool StoryStreamReader::readStatDefinitions(QVector<StatDefinition> &stats) {
+  stats.clear();
+  if (skipWhitespace() != '[') {
+    return skipValue();
+  }
+
+  return readArray([&]() {
+    if (skipWhitespace() != '{') {
+      qWarning() << "Invalid stat: missing id";
+      return skipValue();
+    }
+    return readStatDefinition(stats);
+  });
+}
+
+bool StoryStreamReader::readStatDefinition(QVector<StatDefinition> &stats) {
+  StatDefinition definition;
+  auto readBound = [&](int &bound) {
+    const int c = skipWhitespace();
+    if (c != '-' && !isDigit(c)) {
+      return skipValue();
+    }
+
+    double number = 0.0;
+    if (!readNumber(&number)) {
+      return false;
+    }
+    if (number >= std::numeric_limits<int>::min() &&
+        number <= std::numeric_limits<int>::max() && int(number) == number) {
+      bound = int(number);
+    }
+    return true;
+  };
+
+  const bool ok = readObject([&](const QByteArray &key) {
+    if (key == "id") {
+      return readStringValue(definition.id);
+    }
+    if (key == "name") {
+      return readStringValue(definition.name);
+    }
+    if (key == "initial") {
+      return readIntValue(definition.initial);
+    }
+    if (key == "min") {
+      return readBound(definition.minimum);
+    }
+    if (key == "max") {
+      return readBound(definition.maximum);
+    }
+    return skipValue();
+  });
+
+  if (!ok) {
+    return false;
+  }
+
+  if (definition.id.isEmpty()) {
+    qWarning() << "Invalid stat: missing id";
+    return true;
+  }
+
+  stats.append(definition);
+  return true;
+}
+
+bool StoryStreamReader::readItemDefinitions(QVector<ItemDefinition> &items) {
+  items.clear();
+  if (skipWhitespace() != '[') {
+    return skipValue();
+  }
+
+  return readArray([&]() {
+    if (skipWhitespace() != '{') {
+      qWarning() << "Invalid item: missing id";
+      return skipValue();
+    }
+    return readItemDefinition(items);
+  });
+}
+
+bool StoryStreamReader::readItemDefinition(QVector<ItemDefinition> &items) {
+  ItemDefinition definition;
+
+  const bool ok = readObject([&](const QByteArray &key) {
+    if (key == "id") {
+      return readStringValue(definition.id);
+    }
+    if (key == "effects") {
+      definition.effects.clear();
+      if (skipWhitespace() != '{') {
+        return skipValue();
+      }
+      return readObject([&](const QByteArray &stat) {
+        ItemEffect effect;
+        effect.stat = QString::fromUtf8(stat);
+        if (!readIntValue(effect.delta)) {
+          return false;
+        }
+        for (ItemEffect &existing : definition.effects) {
+          if (existing.stat == effect.stat) {
+            existing.delta = effect.delta;
+            return true;
+          }
+        }
+        definition.effects.append(effect);
+        return true;
+      });
+    }
+    return skipValue();
+  });
+
+  if (!ok) {
+    return false;
+  }
+
+  if (definition.id.isEmpty()) {
+    qWarning() << "Invalid item: missing id";
+    return true;
+  }
+
+  items.append(definition);
+  return true;
+}
+
+bool StoryStreamReader::readNodes() {
+  return readArray([&]() {
+    if (skipWhitespace() != '{') {
+      qWarning() << "Invalid node: missing id or text";
+      return skipValue();
+    }
+    return readNode();
+  });
+}
+
+bool StoryStreamReader::readNode() {
+  const StoryGraph::Mark nodeStart = m_graph->mark();
+  QString id;
+  QString text;
+  qint64 textOffset = 0;
+  int textLength = 0;
+
+  const bool ok = readObject([&](const QByteArray &key) {
+    if (key == "id") {
+      return readStringValue(id);
+    }
+    if (key == "text") {
+      textLength = 0;
+      if (m_textStore && skipWhitespace() == '"') {
+        textOffset = position();
+        if (!readRawString(nullptr)) {
+          return false;
+        }
+        textLength = static_cast<int>(position() - textOffset);
+        return true;
+      }
+      return readStringValue(text);
+    }
+    if (key == "choices") {
+      m_graph->rollback(nodeStart);
+      if (skipWhitespace() != '[') {
+        return skipValue();
+      }
+      return readChoices();
+    }
+    return skipValue();
+  });
+
+  if (!ok) {
+    return false;
+  }
+
+  const bool hasText = m_textStore ? textLength > 2 : !text.isEmpty();
+  if (id.isEmpty() || !hasText) {
+    qWarning() << "Invalid node: missing id or text";
+    m_graph->rollback(nodeStart);
+    return true;
+  }
+
+  if (m_textStore) {
+    m_graph->addPagedNode(nodeStart, id, m_textSource, textOffset, textLength);
+  } else {
+    m_graph->addNode(nodeStart, id, text);
+  }
+  return true;
+}
+
+bool StoryStreamReader::readChoices() {
+  return readArray([&]() {
+    if (skipWhitespace() != '{') {
+      qWarning() << "Invalid choice: missing text or target";
+      return skipValue();
+    }
+    return readChoice();
+  });
+}
+
+bool StoryStreamReader::readChoice() {
+  const StoryGraph::Mark choiceStart = m_graph->mark();
+  QString text;
+  QString target;
+
+  const bool ok = readObject([&](const QByteArray &key) {
+    if (key == "text") {
+      return readStringValue(text);
+    }
+    if (key == "target") {
+      return readStringValue(target);
+    }
+    if (key == "stats") {
+      m_graph->rollbackStats(choiceStart);
+      if (skipWhitespace() != '{') {
+        return skipValue();
+      }
+      return readStats(choiceStart);
+    }
+    if (key == "items") {
+      m_graph->rollbackItems(choiceStart);
+      if (skipWhitespace() != '[') {
+        return skipValue();
+      }
+      return readItems();
+    }
+    return skipValue();
+  });
+
+  if (!ok) {
+    return false;
+  }
+
+  if (text.isEmpty() || target.isEmpty()) {
+    qWarning() << "Invalid choice: missing text or target";
+    m_graph->rollback(choiceStart);
+    return true;
+  }
+
+  m_graph->addChoice(choiceStart, text, target);
+  return true;
+}
+
+bool StoryStreamReader::readStats(const StoryGraph::Mark &choiceStart) {
+  return readObject([&](const QByteArray &key) {
+    int value = 0;
+    if (!readIntValue(value)) {
+      return false;
+    }
+    m_graph->addStat(choiceStart, QString::fromUtf8(key), value);
+    return true;
+  });
+}
+
+bool StoryStreamReader::readItems() {
+  return readArray([&]() {
+    QString item;
+    if (!readStringValue(item)) {
+      return false;
+    }
+    m_graph->addItem(item);
+    return true;
+  });
+}
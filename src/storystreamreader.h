@@ -0,0 +1,68 @@
+#ifndef STORYSTREAMREADER_H
+#define STORYSTREAMREADER_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include "storygraph.h"
+
+struct StoryFileManifest;
+
+class StoryStreamReader
+{
+public:
+    explicit StoryStreamReader(QIODevice *device);
+
+    void setTextStore(const StoryTextStore *textStore, int textSource);
+    void read(StoryGraph &graph, StoryFileManifest &manifest);
+
+    static bool decodeString(const QByteArray &json, QString &value);
+
+private:
+    bool fill();
+    qint64 position() const;
+    int peekChar();
+    int skipWhitespace();
+    bool consume(char expected);
+
+    bool readRawString(QByteArray *value);
+    bool readString(QString &value);
+    bool readNumber(double *value);
+    bool readLiteral(const char *literal);
+    bool readHex4(uint &value);
+    bool skipValue(int depth = 0);
+
+    template <typename Member>
+    bool readObject(Member member);
+    template <typename Element>
+    bool readArray(Element element);
+
+    bool readStringValue(QString &value);
+    bool readIntValue(int &value);
+
+    bool readStory(StoryFileManifest &manifest, bool &isEmpty);
+    bool readStatDefinitions(QVector<StatDefinition> &stats);
+    bool readStatDefinition(QVector<StatDefinition> &stats);
+    bool readItemDefinitions(QVector<ItemDefinition> &items);
+    bool readItemDefinition(QVector<ItemDefinition> &items);
+    bool readNodes();
+    bool readNode();
+    bool readChoices();
+    bool readChoice();
+    bool readStats(const StoryGraph::Mark &choiceStart);
+    bool readItems();
+
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    qint64 m_bufferOffset;
+    int m_size;
+    int m_pos;
+
+    StoryGraph *m_graph;
+    const StoryTextStore *m_textStore;
+    int m_textSource;
+    QByteArray m_scratch;
+    QByteArray m_number;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "storytextstore.h"
+#include "storystreamreader.h"
+#include <QDebug>
+
+StoryTextStore::StoryTextStore(int cacheBytes) : m_cache(cacheBytes) {}
+
+StoryTextStore::~StoryTextStore() { qDeleteAll(m_sources); }
+
+QSharedPointer<StoryTextStore> StoryTextStore::clone() const {
+  QMutexLocker locker(&m_mutex);
+  QSharedPointer<StoryTextStore> store(new StoryTextStore(m_cache.maxCost()));
+  for (const QFile *file : m_sources) {
+    store->m_sources.append(new QFile(file->fileName()));
+    store->m_sources.last()->open(QIODevice::ReadOnly);
+  }
+  return store;
+}
+
+int StoryTextStore::addSource(const QString &filePath) {
+  QMutexLocker locker(&m_mutex);
+  m_sources.append(new QFile(filePath));
+  m_sources.last()->open(QIODevice::ReadOnly);
+  return m_sources.size() - 1;
+}
+
+void StoryTextStore::reloadSource(int source) {
+  QMutexLocker locker(&m_mutex);
+  if (QFile *file = m_sources.value(source)) {
+    file->close();
+  }
+
+  const QList<quint64> keys = m_cache.keys();
+  for (quint64 key : keys) {
+    if (int(key >> 48) == source) {
+      m_cache.remove(key);
+    }
+  }
+}
+
+QString StoryTextStore::text(int source, qint64 offset, int length) const {
+  const quint64 key = (quint64(source) << 48) | quint64(offset);
+
+  QMutexLocker locker(&m_mutex);
+  if (const QString *cached = m_cache.object(key)) {
+    return *cached;
+  }
+
+  QFile *file = m_sources.value(source);
+  if (!file) {
+    return QString();
+  }
+
+  if (!file->isOpen() && !file->open(QIODevice::ReadOnly)) {
+    qWarning() << "Failed to open story file:" << file->fileName();
+    return QString();
+  }
+
+  QString text;
+  const QByteArray raw = file->seek(offset) ? file->read(length) : QByteArray();
+  if (raw.size() != length || !StoryStreamReader::decodeString(raw, text)) {
+    qWarning() << "Failed to read node text from" << file->fileName();
+    return QString();
+  }
+
+  m_cache.insert(key, new QString(text),
+                 qMax(1, text.size() * static_cast<int>(sizeof(QChar))));
+  return text;
+}
+
+int StoryTextStore::cacheCapacity() const {
+  QMutexLocker locker(&m_mutex);
+  return m_cache.maxCost();
+}
+
+void StoryTextStore::setCacheCapacity(int bytes) {
+  QMutexLocker locker(&m_mutex);
+  m_cache.setMaxCost(bytes);
+}
+
+int StoryTextStore::cachedBytes() const {
+  QMutexLocker locker(&m_mutex);
+  return m_cache.totalCost();
+}
@@ -0,0 +1,36 @@
+#ifndef STORYTEXTSTORE_H
+#define STORYTEXTSTORE_H
+
+#include <QCache>
+#include <QFile>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+class StoryTextStore
+{
+public:
+    static const int DefaultCacheBytes = 4 * 1024 * 1024;
+
+    explicit StoryTextStore(int cacheBytes = DefaultCacheBytes);
+    ~StoryTextStore();
+
+    QSharedPointer<StoryTextStore> clone() const;
+    int addSource(const QString &filePath);
+    void reloadSource(int source);
+    QString text(int source, qint64 offset, int length) const;
+
+    int cacheCapacity() const;
+    void setCacheCapacity(int bytes);
+    int cachedBytes() const;
+
+private:
+    Q_DISABLE_COPY(StoryTextStore)
+
+    mutable QMutex m_mutex;
+    QVector<QFile*> m_sources;
+    mutable QCache<quint64, QString> m_cache;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "symboltable.h"
+#include <QHash>
+#include <cstring>
+
+namespace {
+
+const int MinimumCapacity = 16;
+const quint64 FnvOffset = 14695981039346656037ull;
+const quint64 FnvPrime = 1099511628211ull;
+
+uint hashChars(const QChar *data, int length) {
+  return qHashBits(data, size_t(length) * sizeof(QChar));
+}
+
+} // namespace
+
+SymbolTable::SymbolTable() : m_fingerprint(FnvOffset) {}
+
+int SymbolTable::intern(const QString &name) {
+  return intern(name.constData(), name.size());
+}
+
+int SymbolTable::intern(const QStringRef &name) {
+  return intern(name.unicode(), name.size());
+}
+
+int SymbolTable::intern(const QChar *data, int length) {
+  const uint hash = hashChars(data, length);
+  if (m_slots.isEmpty()) {
+    rehash(MinimumCapacity);
+  }
+
+  int slot = findSlot(data, length, hash);
+  if (m_slots[slot] >= 0) {
+    return m_slots[slot];
+  }
+
+  if ((m_entries.size() + 1) * 4 > m_slots.size() * 3) {
+    rehash(m_slots.size() * 2);
+    slot = findSlot(data, length, hash);
+  }
+
+  Entry entry;
+  entry.offset = m_chars.size();
+  entry.length = length;
+  entry.hash = hash;
+  m_chars.append(data, length);
+  for (int i = 0; i < length; ++i) {
+    m_fingerprint = (m_fingerprint ^ data[i].unicode()) * FnvPrime;
+  }
+  m_fingerprint = (m_fingerprint ^ 0xffff) * FnvPrime;
+
+  const int symbol = m_entries.size();
+  m_entries.append(entry);
+  m_slots[slot] = symbol;
+  return symbol;
+}
+
+int SymbolTable::find(const QString &name) const {
+  if (m_slots.isEmpty()) {
+    return -1;
+  }
+
+  const uint hash = hashChars(name.constData(), name.size());
+  return m_slots[findSlot(name.constData(), name.size(), hash)];
+}
+
+int SymbolTable::find(const QStringRef &name) const {
+  if (m_slots.isEmpty()) {
+    return -1;
+  }
+
+  const uint hash = hashChars(name.unicode(), name.size());
+  return m_slots[findSlot(name.unicode(), name.size(), hash)];
+}
+
+QString SymbolTable::name(int symbol) const {
+  if (symbol < 0 || symbol >= m_entries.size()) {
+    return QString();
+  }
+  const Entry &entry = m_entries[symbol];
+  return m_chars.mid(entry.offset, entry.length);
+}
+
+quint64 SymbolTable::fingerprint() const {
+  return (m_fingerprint ^ quint64(m_entries.size())) * FnvPrime;
+}
+
+int SymbolTable::size() const { return m_entries.size(); }
+
+bool SymbolTable::isEmpty() const { return m_entries.isEmpty(); }
+
+void SymbolTable::reserve(int size) {
+  m_entries.reserve(size);
+
+  int capacity = MinimumCapacity;
+  while (capacity * 3 < size * 4) {
+    capacity *= 2;
+  }
+  if (capacity > m_slots.size()) {
+    rehash(capacity);
+  }
+}
+
+void SymbolTable::clear() {
+  m_chars.clear();
+  m_entries.clear();
+  m_slots.clear();
+  m_fingerprint = FnvOffset;
+}
+
+int SymbolTable::findSlot(const QChar *data, int length, uint hash) const {
+  const int mask = m_slots.size() - 1;
+  int slot = static_cast<int>(hash) & mask;
+
+  for (;;) {
+    const int symbol = m_slots[slot];
+    if (symbol < 0) {
+      return slot;
+    }
+
+    const Entry &entry = m_entries[symbol];
+    if (entry.hash == hash && entry.length == length &&
+        std::memcmp(m_chars.constData() + entry.offset, data,
+                    size_t(length) * sizeof(QChar)) == 0) {
+      return slot;
+    }
+    slot = (slot + 1) & mask;
+  }
+}
+
+void SymbolTable::rehash(int capacity) {
+  m_slots.fill(-1, capacity);
+
+  const int mask = capacity - 1;
+  for (int symbol = 0; symbol < m_entries.size(); ++symbol) {
+    int slot = static_cast<int>(m_entries[symbol].hash) & mask;
+    while (m_slots[slot] >= 0) {
+      slot = (slot + 1) & mask;
+    }
+    m_slots[slot] = symbol;
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <QString>
+#include <QStringRef>
+#include <QVector>
+
+class SymbolTable
+{
+public:
+    SymbolTable();
+
+    int intern(const QString &name);
+    int intern(const QStringRef &name);
+    int find(const QString &name) const;
+    int find(const QStringRef &name) const;
+    QString name(int symbol) const;
+    quint64 fingerprint() const;
+
+    int size() const;
+    bool isEmpty() const;
+    void reserve(int size);
+    void clear();
+
+private:
+    struct Entry {
+        int offset;
+        int length;
+        uint hash;
+    };
+
+    int intern(const QChar *data, int length);
+    int findSlot(const QChar *data, int length, uint hash) const;
+    void rehash(int capacity);
+
+    QString m_chars;
+    QVector<Entry> m_entries;
+    QVector<int> m_slots;
+    quint64 m_fingerprint;
+};
+
+struct StorySymbols {
+    SymbolTable nodes;
+    SymbolTable stats;
+    SymbolTable items;
+};
+
+#endif
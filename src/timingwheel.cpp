@@ -0,0 +1,131 @@
+#include "timingwheel.h"
+#include <QCoreApplication>
+#include <limits>
+
+TimingWheel::TimingWheel(int tickMs, QObject *parent)
+    : QObject(parent), m_slots(SlotCount), m_tickMs(qMax(1, tickMs)) {
+  m_timer.setSingleShot(true);
+  m_timer.setTimerType(Qt::CoarseTimer);
+  m_clock.start();
+  connect(&m_timer, &QTimer::timeout, this, &TimingWheel::tick);
+}
+
+TimingWheel *TimingWheel::shared() {
+  static QPointer<TimingWheel> wheel;
+  if (!wheel) {
+    wheel = new TimingWheel(DefaultTickMs, QCoreApplication::instance());
+  }
+  return wheel;
+}
+
+int TimingWheel::schedule(int delayMs, QObject *context,
+                          const std::function<void()> &callback) {
+  const int ticks = qMax(1, (delayMs + m_tickMs - 1) / m_tickMs);
+
+  Entry entry;
+  entry.id = m_nextId++;
+  entry.due = elapsedMs() / m_tickMs + ticks;
+  entry.context = context;
+  entry.callback = callback;
+  m_slots[int(entry.due % SlotCount)].append(entry);
+
+  ++m_pending;
+  updateTimer();
+  return entry.id;
+}
+
+void TimingWheel::cancel(int id) {
+  for (Entry &entry : m_firing) {
+    if (entry.id == id) {
+      entry.callback = nullptr;
+      return;
+    }
+  }
+
+  for (QVector<Entry> &slot : m_slots) {
+    for (int i = 0; i < slot.size(); ++i) {
+      if (slot[i].id == id) {
+        slot.remove(i);
+        --m_pending;
+        updateTimer();
+        return;
+      }
+    }
+  }
+}
+
+int TimingWheel::pendingCount() const { return m_pending; }
+
+bool TimingWheel::isPaused() const { return m_paused; }
+
+void TimingWheel::setPaused(bool paused) {
+  if (paused && !m_paused) {
+    m_elapsedMs += m_clock.elapsed();
+  } else if (!paused && m_paused) {
+    m_clock.restart();
+  }
+  m_paused = paused;
+  updateTimer();
+}
+
+void TimingWheel::tick() {
+  const qint64 now = elapsedMs() / m_tickMs;
+  for (qint64 tick = qMax(m_tick + 1, now - SlotCount + 1); tick <= now;
+       ++tick) {
+    QVector<Entry> &slot = m_slots[int(tick % SlotCount)];
+    for (int i = 0; i < slot.size();) {
+      if (slot[i].due <= now) {
+        m_firing.append(slot[i]);
+        slot.remove(i);
+        --m_pending;
+      } else {
+        ++i;
+      }
+    }
+  }
+  m_tick = qMax(m_tick, now);
+
+  for (int i = 0; i < m_firing.size(); ++i) {
+    const Entry &entry = m_firing[i];
+    if (entry.callback && entry.context) {
+      const std::function<void()> callback = entry.callback;
+      callback();
+    }
+  }
+  m_firing.clear();
+  updateTimer();
+}
+
+qint64 TimingWheel::elapsedMs() const {
+  return m_paused ? m_elapsedMs : m_elapsedMs + m_clock.elapsed();
+}
+
+qint64 TimingWheel::nextDue() const {
+  for (qint64 tick = m_tick + 1; tick <= m_tick + SlotCount; ++tick) {
+    for (const Entry &entry : m_slots[int(tick % SlotCount)]) {
+      if (entry.due == tick) {
+        return tick;
+      }
+    }
+  }
+
+  qint64 due = -1;
+  for (const QVector<Entry> &slot : m_slots) {
+    for (const Entry &entry : slot) {
+      if (due < 0 || entry.due < due) {
+        due = entry.due;
+      }
+    }
+  }
+  return due;
+}
+
+void TimingWheel::updateTimer() {
+  if (m_pending == 0 || m_paused) {
+    m_timer.stop();
+    return;
+  }
+
+  const qint64 delay = nextDue() * m_tickMs - elapsedMs();
+  m_timer.start(int(qBound<qint64>(0, delay, std::numeric_limits<int>::max())));
+}
@@ -0,0 +1,57 @@
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+#include <functional>
+
+class TimingWheel : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DefaultTickMs = 100;
+    static const int SlotCount = 64;
+
+    explicit TimingWheel(int tickMs = DefaultTickMs, QObject *parent = nullptr);
+
+    static TimingWheel *shared();
+
+    int schedule(int delayMs, QObject *context, const std::function<void()> &callback);
+    void cancel(int id);
+    int pendingCount() const;
+
+    bool isPaused() const;
+    void setPaused(bool paused);
+
+private slots:
+    void tick();
+
+private:
+    struct Entry {
+        int id = 0;
+        qint64 due = 0;
+        QPointer<QObject> context;
+        std::function<void()> callback;
+    };
+
+    qint64 elapsedMs() const;
+    qint64 nextDue() const;
+    void updateTimer();
+
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    QVector<QVector<Entry>> m_slots;
+    QVector<Entry> m_firing;
+    int m_tickMs;
+    qint64 m_tick = 0;
+    qint64 m_elapsedMs = 0;
+    int m_nextId = 1;
+    int m_pending = 0;
+    bool m_paused = false;
+};
+
+#endif
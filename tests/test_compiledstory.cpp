@@ -0,0 +1,191 @@
+#include "storycompiler.h"
+#include "storyloader.h"
+#include "testutil.h"
+#include <QFile>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+const char PartOne[] = R"({
+  "story": {
+    "title": "Compiled",
+    "startNode": "start",
+    "stats": [{"id": "health", "initial": 10}],
+    "items": [{"id": "lamp", "effects": {"health": 1}}],
+    "nodes": [
+      {"id": "start", "text": "Start", "choices": [
+        {"text": "Go", "target": "end", "stats": {"health": -2},
+         "items": ["lamp"]},
+        {"text": "Wander", "target": "nowhere"}
+      ]},
+      {"id": "end", "text": "The end"}
+    ]
+  }
+})";
+
+const char PartTwo[] = R"({
+  "story": {
+    "title": "Compiled",
+    "startNode": "start",
+    "nodes": [{"id": "extra", "text": "Extra"}]
+  }
+})";
+
+} // namespace
+
+class CompiledStoryTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+  void cleanup();
+  void loadsRecordsIntoArena();
+  void acceptsUnchangedSources();
+  void acceptsTouchedSourceWithSameContent();
+  void rejectsSourceWithOtherSize();
+  void rejectsSourceWithOtherContent();
+  void rejectsOtherFileList();
+  void rejectsCorruptFile();
+  void fallsBackToJson();
+
+private:
+  QString path(const QString &name) const;
+  void editSource(int file, const QByteArray &from, const QByteArray &to);
+
+  QScopedPointer<QTemporaryDir> m_dir;
+  QStringList m_files;
+  QString m_compiled;
+};
+
+void CompiledStoryTest::init() {
+  m_dir.reset(new QTemporaryDir);
+  QVERIFY(m_dir->isValid());
+
+  m_files = QStringList() << path("part1.json") << path("part2.json");
+  QVERIFY(writeTestFile(m_files[0], PartOne));
+  QVERIFY(writeTestFile(m_files[1], PartTwo));
+
+  m_compiled = StoryLoader::compiledStoryPath(m_files);
+  QString errorMsg;
+  QVERIFY2(StoryCompiler::compile(m_files, m_compiled, errorMsg),
+           qPrintable(errorMsg));
+}
+
+void CompiledStoryTest::cleanup() { m_dir.reset(); }
+
+void CompiledStoryTest::loadsRecordsIntoArena() {
+  const LoadedStory story = StoryLoader::loadCompiled(m_compiled, m_files);
+  QVERIFY2(!story.hasErrors(), qPrintable(story.errorString()));
+  QCOMPARE(story.files.first().title, QString("Compiled"));
+  QCOMPARE(story.files.first().startNodeId, QString("start"));
+
+  const StoryGraph &graph = *story.graph;
+  QCOMPARE(graph.nodeCount(), 3);
+  const int start = graph.findNode("start");
+  const int end = graph.findNode("end");
+  QVERIFY(start >= 0 && end >= 0 && graph.findNode("extra") >= 0);
+  QCOMPARE(graph.node(start).text(), QString("Start"));
+  QVERIFY(graph.node(end).isEndNode());
+
+  const StoryNode &node = graph.node(start);
+  QCOMPARE(node.choiceCount(), 2);
+  QCOMPARE(node.choice(0).text(), QString("Go"));
+  QCOMPARE(node.choice(0).targetNode(), end);
+  QCOMPARE(node.choice(1).targetNode(), -1);
+  QCOMPARE(graph.danglingChoices().size(), 1);
+
+  const int health = graph.symbols().stats.find("health");
+  const int lamp = graph.symbols().items.find("lamp");
+  const ConstSpan<StatDelta> deltas = node.choice(0).statDeltas();
+  QCOMPARE(deltas.size(), 1);
+  QCOMPARE(deltas[0].stat, health);
+  QCOMPARE(deltas[0].delta, -2);
+  const ConstSpan<int> items = node.choice(0).itemSymbols();
+  QCOMPARE(items.size(), 1);
+  QCOMPARE(items[0], lamp);
+  QCOMPARE(graph.itemEffects(lamp).size(), 1);
+  QCOMPARE(graph.statDefinition(health).initial, 10);
+}
+
+void CompiledStoryTest::acceptsUnchangedSources() {
+  const LoadedStory story = StoryLoader::loadCompiled(m_compiled, m_files);
+  QVERIFY2(!story.hasErrors(), qPrintable(story.errorString()));
+}
+
+void CompiledStoryTest::acceptsTouchedSourceWithSameContent() {
+  QVERIFY(touchTestFile(m_files[0], 60));
+  const LoadedStory story = StoryLoader::loadCompiled(m_compiled, m_files);
+  QVERIFY2(!story.hasErrors(), qPrintable(story.errorString()));
+}
+
+void CompiledStoryTest::rejectsSourceWithOtherSize() {
+  editSource(1, "Extra", "Extra text");
+  const LoadedStory story = StoryLoader::loadCompiled(m_compiled, m_files);
+  QVERIFY(story.hasErrors());
+  QVERIFY(story.errorString().contains("built from other sources"));
+}
+
+void CompiledStoryTest::rejectsSourceWithOtherContent() {
+  editSource(0, "The end", "The fin");
+  QVERIFY(touchTestFile(m_files[0], 60));
+  const LoadedStory story = StoryLoader::loadCompiled(m_compiled, m_files);
+  QVERIFY(story.hasErrors());
+  QVERIFY(story.errorString().contains("built from other sources"));
+}
+
+void CompiledStoryTest::rejectsOtherFileList() {
+  QVERIFY(StoryLoader::loadCompiled(m_compiled, QStringList(m_files[0]))
+              .hasErrors());
+
+  const QStringList reversed = QStringList() << m_files[1] << m_files[0];
+  QVERIFY(StoryLoader::loadCompiled(m_compiled, reversed).hasErrors());
+
+  const QString copy = path("copy.json");
+  QVERIFY(QFile::copy(m_files[1], copy));
+  const QStringList renamed = QStringList() << m_files[0] << copy;
+  QVERIFY(StoryLoader::loadCompiled(m_compiled, renamed).hasErrors());
+}
+
+void CompiledStoryTest::rejectsCorruptFile() {
+  QFile file(m_compiled);
+  QVERIFY(file.open(QIODevice::ReadWrite));
+  QByteArray data = file.readAll();
+  data[data.size() - 1] = char(data[data.size() - 1] ^ 0x5a);
+  QVERIFY(file.seek(0));
+  QCOMPARE(file.write(data), qint64(data.size()));
+  file.close();
+
+  const LoadedStory story = StoryLoader::loadCompiled(m_compiled, m_files);
+  QVERIFY(story.hasErrors());
+  QVERIFY(story.errorString().contains("Checksum mismatch"));
+}
+
+void CompiledStoryTest::fallsBackToJson() {
+  editSource(0, "The end", "The finale");
+
+  const LoadedStory story = StoryLoader::loadStory(m_files);
+  QVERIFY2(!story.hasErrors(), qPrintable(story.errorString()));
+  QVERIFY(story.compiledPath.isEmpty());
+  const StoryGraph &graph = *story.graph;
+  QCOMPARE(graph.node(graph.findNode("end")).text(), QString("The finale"));
+}
+
+QString CompiledStoryTest::path(const QString &name) const {
+  return m_dir->filePath(name);
+}
+
+void CompiledStoryTest::editSource(int file, const QByteArray &from,
+                                   const QByteArray &to) {
+  QFile source(m_files[file]);
+  QVERIFY(source.open(QIODevice::ReadOnly));
+  QByteArray data = source.readAll();
+  source.close();
+  QVERIFY(data.contains(from));
+  QVERIFY(writeTestFile(m_files[file], data.replace(from, to)));
+}
+
+QTEST_GUILESS_MAIN(CompiledStoryTest)
+
+#include "test_compiledstory.moc"
@@ -0,0 +1,208 @@
+#include "story.h"
+#include "testutil.h"
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+QByteArray storyJson(const QByteArray &middleChoices,
+                     const QByteArray &extraNodes = QByteArray(),
+                     const QByteArray &endText = "The end") {
+  return R"({
+  "story": {
+    "title": "Reload",
+    "startNode": "start",
+    "nodes": [
+      {"id": "start", "text": "Start", "choices": [
+        {"text": "On", "target": "middle"}
+      ]},
+      {"id": "middle", "text": "Middle", "choices": [)" +
+         middleChoices + R"(]},
+      )" + extraNodes +
+         R"({"id": "end", "text": ")" + endText + R"("}
+    ]
+  }
+})";
+}
+
+const char OneChoice[] = R"({"text": "End", "target": "end"})";
+const char TwoChoices[] = R"({"text": "End", "target": "end"},
+        {"text": "Back", "target": "start"})";
+const char SideNode[] = R"({"id": "side", "text": "Side"},
+      )";
+
+} // namespace
+
+class HotReloadTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+  void cleanup();
+  void reportsDiff();
+  void removedNodeIsNotAnEnding();
+  void compactsRulesAfterRepeatedReloads();
+  void detectsPagedTextEdit();
+
+private:
+  QSharedPointer<Story> load(const QByteArray &json,
+                             const StoryLoadOptions &options);
+  StoryReload reload(const QByteArray &json, const StoryLoadOptions &options);
+  int liveTransitions() const;
+
+  QScopedPointer<QTemporaryDir> m_dir;
+  QString m_file;
+  QSharedPointer<Story> m_story;
+};
+
+void HotReloadTest::init() {
+  m_dir.reset(new QTemporaryDir);
+  QVERIFY(m_dir->isValid());
+  m_file = m_dir->filePath("story.json");
+}
+
+void HotReloadTest::cleanup() {
+  m_story.clear();
+  m_dir.reset();
+}
+
+void HotReloadTest::reportsDiff() {
+  StoryLoadOptions options;
+  options.compiled = false;
+  m_story = load(storyJson(OneChoice, SideNode), options);
+  QVERIFY(m_story);
+
+  const StoryReload result =
+      reload(storyJson(TwoChoices,
+                       R"({"id": "cellar", "text": "Cellar"},
+      )"),
+             options);
+  QVERIFY(!result.hasErrors());
+  QCOMPARE(result.diff.added, 1);
+  QCOMPARE(result.diff.changed, 1);
+  QCOMPARE(result.diff.removed, 1);
+  QCOMPARE(result.diff.nodes.size(), 3);
+
+  const StoryGraph &graph = m_story->graph();
+  const StoryNode &middle = graph.node(graph.findNode("middle"));
+  QCOMPARE(middle.choiceCount(), 2);
+  QCOMPARE(middle.choice(1).targetNode(), graph.findNode("start"));
+  QCOMPARE(graph.node(graph.findNode("cellar")).text(), QString("Cellar"));
+  QCOMPARE(m_story->fingerprint(), graph.fingerprint());
+
+  const StoryReload unchanged =
+      reload(storyJson(TwoChoices,
+                       R"({"id": "cellar", "text": "Cellar"},
+      )"),
+             options);
+  QCOMPARE(unchanged.diff.added, 0);
+  QCOMPARE(unchanged.diff.changed, 0);
+  QCOMPARE(unchanged.diff.removed, 0);
+}
+
+void HotReloadTest::removedNodeIsNotAnEnding() {
+  StoryLoadOptions options;
+  options.compiled = false;
+  m_story = load(storyJson(OneChoice, SideNode), options);
+  QVERIFY(m_story);
+
+  const StoryGraph &graph = m_story->graph();
+  const int side = graph.findNode("side");
+  QVERIFY(graph.node(side).isEndNode());
+
+  const StoryReload result = reload(storyJson(OneChoice), options);
+  QVERIFY(!result.hasErrors());
+  QCOMPARE(result.diff.removed, 1);
+  QVERIFY(graph.node(side).isRemoved());
+  QVERIFY(!graph.node(side).isEndNode());
+  QVERIFY(graph.node(graph.findNode("end")).isEndNode());
+}
+
+void HotReloadTest::compactsRulesAfterRepeatedReloads() {
+  StoryLoadOptions options;
+  options.compiled = false;
+  m_story = load(storyJson(OneChoice), options);
+  QVERIFY(m_story);
+  QVERIFY(m_story->rules().isPacked());
+
+  bool grew = false;
+  bool compacted = false;
+  for (int i = 1; i <= 8 && !compacted; ++i) {
+    const StoryReload result =
+        reload(storyJson(i % 2 ? TwoChoices : OneChoice), options);
+    QVERIFY(!result.hasErrors());
+    QCOMPARE(result.diff.changed, 1);
+    grew = grew || !m_story->rules().isPacked();
+    compacted = !result.movedTransitions.isEmpty();
+  }
+  QVERIFY(grew);
+  QVERIFY(compacted);
+
+  const StoryRules &rules = m_story->rules();
+  const StoryGraph &graph = m_story->graph();
+  QVERIFY(rules.isPacked());
+  QCOMPARE(rules.totalTransitions(), liveTransitions());
+  for (int node = 0; node < graph.nodeCount(); ++node) {
+    const StoryNode &storyNode = graph.node(node);
+    QCOMPARE(rules.transitionCount(node), storyNode.choiceCount());
+    for (int i = 0; i < storyNode.choiceCount(); ++i) {
+      QCOMPARE(rules.transition(rules.firstTransition(node) + i).target,
+               storyNode.choice(i).targetNode());
+    }
+  }
+}
+
+void HotReloadTest::detectsPagedTextEdit() {
+  StoryLoadOptions options;
+  options.compiled = false;
+  options.pagedText = true;
+  m_story = load(storyJson(OneChoice), options);
+  QVERIFY(m_story);
+
+  const StoryReload result =
+      reload(storyJson(OneChoice, QByteArray(), "The fin"), options);
+  QVERIFY(!result.hasErrors());
+  QCOMPARE(result.diff.changed, 1);
+
+  const StoryGraph &graph = m_story->graph();
+  QCOMPARE(graph.node(graph.findNode("end")).text(), QString("The fin"));
+}
+
+QSharedPointer<Story> HotReloadTest::load(const QByteArray &json,
+                                          const StoryLoadOptions &options) {
+  if (!writeTestFile(m_file, json)) {
+    return QSharedPointer<Story>();
+  }
+
+  QString errorMsg;
+  QSharedPointer<Story> story =
+      Story::load(QStringList(m_file), options, errorMsg);
+  if (!story) {
+    qWarning() << errorMsg;
+  }
+  return story;
+}
+
+StoryReload HotReloadTest::reload(const QByteArray &json,
+                                  const StoryLoadOptions &options) {
+  StoryReload result;
+  if (!writeTestFile(m_file, json)) {
+    result.errors.append("Failed to write " + m_file);
+    return result;
+  }
+  return m_story->reloadFile(0, m_file, options);
+}
+
+int HotReloadTest::liveTransitions() const {
+  const StoryGraph &graph = m_story->graph();
+  int count = 0;
+  for (int node = 0; node < graph.nodeCount(); ++node) {
+    count += graph.node(node).choiceCount();
+  }
+  return count;
+}
+
+QTEST_GUILESS_MAIN(HotReloadTest)
+
+#include "test_hotreload.moc"
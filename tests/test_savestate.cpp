@@ -0,0 +1,177 @@
+#include "gameengine.h"
+#include "testutil.h"
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+QByteArray storyJson(const QByteArray &extraNodes = QByteArray()) {
+  return R"({
+  "story": {
+    "title": "Session",
+    "startNode": "start",
+    "stats": [{"id": "health", "initial": 10, "min": 0, "max": 20}],
+    "items": [{"id": "lamp", "effects": {"health": 1}}],
+    "nodes": [
+      {"id": "start", "text": "Start", "choices": [
+        {"text": "Take the lamp", "target": "hall", "stats": {"health": -3},
+         "items": ["lamp"]},
+        {"text": "Leave", "target": "gone"}
+      ]},
+      {"id": "hall", "text": "Hall", "choices": [
+        {"text": "Rest", "target": "end", "stats": {"health": 2}}
+      ]},
+      )" + extraNodes +
+         R"({"id": "gone", "text": "Gone"},
+      {"id": "end", "text": "The end"}
+    ]
+  }
+})";
+}
+
+} // namespace
+
+class SaveStateTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+  void cleanup();
+  void restoresSession();
+  void rejectsWithoutStory();
+  void rejectsOtherMagic();
+  void rejectsOtherVersion();
+  void rejectsOtherStory();
+  void rejectsTruncatedSession();
+  void rejectsTrailingData();
+
+private:
+  QString writeStory(const QString &name, const QByteArray &json);
+  QByteArray playedSession();
+  void expectRejected(const QByteArray &data, const QString &error);
+
+  QScopedPointer<QTemporaryDir> m_dir;
+  QString m_file;
+  QScopedPointer<GameEngine> m_engine;
+};
+
+void SaveStateTest::init() {
+  m_dir.reset(new QTemporaryDir);
+  QVERIFY(m_dir->isValid());
+  m_file = writeStory("story.json", storyJson());
+  QVERIFY(!m_file.isEmpty());
+
+  m_engine.reset(new GameEngine);
+  m_engine->loadStoryFiles(QStringList(m_file));
+  QCOMPARE(m_engine->currentNodeId(), QString("start"));
+}
+
+void SaveStateTest::cleanup() {
+  m_engine.reset();
+  m_dir.reset();
+}
+
+void SaveStateTest::restoresSession() {
+  const QByteArray data = playedSession();
+  QVERIFY(!data.isEmpty());
+
+  GameEngine restored;
+  restored.loadStoryFiles(QStringList(m_file));
+  QString errorMsg;
+  QVERIFY2(restored.loadState(data, errorMsg), qPrintable(errorMsg));
+
+  QCOMPARE(restored.currentNodeId(), QString("end"));
+  QVERIFY(restored.isGameEnded());
+  QCOMPARE(restored.choicesMade(), 2);
+  QCOMPARE(restored.nodesVisited(), m_engine->nodesVisited());
+  QCOMPARE(restored.stat("health"), m_engine->stat("health"));
+  QCOMPARE(restored.inventory(), QStringList("lamp"));
+  QCOMPARE(restored.endingsFound(), QStringList("end"));
+  QVERIFY(restored.isChoicePreviouslySelected("start", 0));
+  QVERIFY(!restored.isChoicePreviouslySelected("start", 1));
+  QVERIFY(restored.isChoicePreviouslySelected("hall", 0));
+  QCOMPARE(restored.undoDepth(), 2);
+
+  restored.goBack();
+  QCOMPARE(restored.currentNodeId(), QString("hall"));
+  QCOMPARE(restored.choicesMade(), 1);
+  QCOMPARE(restored.inventory(), QStringList("lamp"));
+  restored.goBack();
+  QCOMPARE(restored.currentNodeId(), QString("start"));
+  QCOMPARE(restored.stat("health"), 10);
+  QVERIFY(restored.inventory().isEmpty());
+  QVERIFY(!restored.canGoBack());
+}
+
+void SaveStateTest::rejectsWithoutStory() {
+  const QByteArray data = playedSession();
+  GameEngine empty;
+  QString errorMsg;
+  QVERIFY(!empty.loadState(data, errorMsg));
+  QCOMPARE(errorMsg, QString("No story loaded"));
+}
+
+void SaveStateTest::rejectsOtherMagic() {
+  QByteArray data = playedSession();
+  data[0] = char(data[0] ^ 0x20);
+  expectRejected(data, "Not a saved session");
+  expectRejected(QByteArray(), "Not a saved session");
+}
+
+void SaveStateTest::rejectsOtherVersion() {
+  QByteArray data = playedSession();
+  data[4] = char(0x7f);
+  expectRejected(data, "Unsupported session version 127");
+}
+
+void SaveStateTest::rejectsOtherStory() {
+  const QByteArray data = playedSession();
+  const QString other =
+      writeStory("other.json", storyJson(R"({"id": "cellar", "text": "Cellar"},
+      )"));
+  QVERIFY(!other.isEmpty());
+  m_engine->loadStoryFiles(QStringList(other));
+  expectRejected(data, "Saved session belongs to a different story");
+}
+
+void SaveStateTest::rejectsTruncatedSession() {
+  const QByteArray data = playedSession();
+  for (int size = 13; size < data.size(); ++size) {
+    expectRejected(data.left(size), "Saved session is corrupt");
+  }
+}
+
+void SaveStateTest::rejectsTrailingData() {
+  expectRejected(playedSession() + char(0), "Saved session is corrupt");
+}
+
+QString SaveStateTest::writeStory(const QString &name, const QByteArray &json) {
+  const QString filePath = m_dir->filePath(name);
+  return writeTestFile(filePath, json) ? filePath : QString();
+}
+
+QByteArray SaveStateTest::playedSession() {
+  m_engine->restart();
+  m_engine->makeChoice(0);
+  m_engine->makeChoice(0);
+  return m_engine->currentNodeId() == "end" ? m_engine->saveState()
+                                             : QByteArray();
+}
+
+void SaveStateTest::expectRejected(const QByteArray &data,
+                                   const QString &error) {
+  const QString node = m_engine->currentNodeId();
+  const int choicesMade = m_engine->choicesMade();
+  const int undoDepth = m_engine->undoDepth();
+  QString errorMsg;
+  QVERIFY(!m_engine->loadState(data, errorMsg));
+  QCOMPARE(errorMsg, error);
+  QCOMPARE(m_engine->currentNodeId(), node);
+  QCOMPARE(m_engine->choicesMade(), choicesMade);
+  QCOMPARE(m_engine->undoDepth(), undoDepth);
+}
+
+QTEST_GUILESS_MAIN(SaveStateTest)
+
+#include "test_savestate.moc"
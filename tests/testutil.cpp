@@ -0,0 +1,22 @@
+#include "testutil.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
+bool writeTestFile(const QString &filePath, const QByteArray &data) {
+  QFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return false;
+  }
+  return file.write(data) == data.size();
+}
+
+bool touchTestFile(const QString &filePath, int seconds) {
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadWrite)) {
+    return false;
+  }
+  const QDateTime modified =
+      QFileInfo(filePath).lastModified().addSecs(seconds);
+  return file.setFileTime(modified, QFileDevice::FileModificationTime);
+}
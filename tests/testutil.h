@@ -0,0 +1,10 @@
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+#include <QByteArray>
+#include <QString>
+
+bool writeTestFile(const QString &filePath, const QByteArray &data);
+bool touchTestFile(const QString &filePath, int seconds);
+
+#endif
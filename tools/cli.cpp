@@ -0,0 +1,149 @@
+#include "gameengine.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+bool readScript(QIODevice &device, QVector<QVector<int>> &runs,
+                QString &errorMsg) {
+  const QRegularExpression separators("[\\s,]+");
+  QTextStream in(&device);
+  int lineNumber = 0;
+  while (!in.atEnd()) {
+    QString line = in.readLine();
+    ++lineNumber;
+    const int comment = line.indexOf('#');
+    if (comment >= 0) {
+      line.truncate(comment);
+    }
+
+    QVector<int> choices;
+    const QStringList tokens = line.split(separators);
+    for (const QString &token : tokens) {
+      if (token.isEmpty()) {
+        continue;
+      }
+      bool ok = false;
+      const int choice = token.toInt(&ok);
+      if (!ok || choice < 0) {
+        errorMsg = QString("Invalid choice '%1' on line %2")
+                       .arg(token)
+                       .arg(lineNumber);
+        return false;
+      }
+      choices.append(choice);
+    }
+    if (!choices.isEmpty()) {
+      runs.append(choices);
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("rencpp-cli");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Plays scripted choice sequences against a story without a UI. Each "
+      "script line is one playthrough from the start: zero-based choice "
+      "indices separated by spaces or commas; '#' starts a comment.");
+  parser.addHelpOption();
+  parser.addOption({{"s", "script"},
+                    "Read choice sequences from <file> instead of stdin.",
+                    "file"});
+  parser.addOption({{"r", "repeat"}, "Play the whole script <count> times.",
+                    "count", "1"});
+  parser.addOption({"undo-limit",
+                    "Undo memory limit in bytes (0 = unlimited).", "bytes",
+                    QString::number(GameEngine::DefaultUndoMemoryLimit)});
+  parser.addPositionalArgument(
+      "stories",
+      "Story JSON files; the first one defines title and start. Defaults to "
+      "the bundled story.",
+      "[<story.json>...]");
+  parser.process(app);
+
+  QTextStream err(stderr);
+  QVector<QVector<int>> runs;
+  QString errorMsg;
+  if (parser.isSet("script")) {
+    QFile scriptFile(parser.value("script"));
+    if (!scriptFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+      err << "rencpp-cli: Cannot open script " << scriptFile.fileName()
+          << "\n";
+      return 1;
+    }
+    if (!readScript(scriptFile, runs, errorMsg)) {
+      err << "rencpp-cli: " << errorMsg << "\n";
+      return 1;
+    }
+  } else {
+    QFile input;
+    if (!input.open(stdin, QIODevice::ReadOnly | QIODevice::Text) ||
+        !readScript(input, runs, errorMsg)) {
+      err << "rencpp-cli: " << (errorMsg.isEmpty() ? "Cannot read stdin"
+                                                   : errorMsg)
+          << "\n";
+      return 1;
+    }
+  }
+
+  GameEngine engine;
+  engine.setUndoMemoryLimit(parser.value("undo-limit").toLongLong());
+  QObject::connect(&engine, &GameEngine::errorOccurred,
+                   [&err](const QString &error) {
+                     err << "rencpp-cli: " << error << "\n";
+                   });
+
+  const QStringList storyFiles = parser.positionalArguments();
+  engine.loadStoryFiles(storyFiles.isEmpty() ? engine.storyFiles()
+                                             : storyFiles);
+  if (engine.currentNodeId().isEmpty()) {
+    return 1;
+  }
+
+  const int repeat = qMax(1, parser.value("repeat").toInt());
+  qint64 transitions = 0;
+  qint64 rejected = 0;
+  qint64 endings = 0;
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int pass = 0; pass < repeat; ++pass) {
+    for (const QVector<int> &choices : qAsConst(runs)) {
+      engine.restart();
+      for (int choice : choices) {
+        const int before = engine.choicesMade();
+        engine.makeChoice(choice);
+        if (engine.choicesMade() == before) {
+          ++rejected;
+        } else {
+          ++transitions;
+        }
+      }
+      if (engine.isGameEnded()) {
+        ++endings;
+      }
+    }
+  }
+  const qint64 elapsedNs = timer.nsecsElapsed();
+
+  const double seconds = elapsedNs / 1e9;
+  QTextStream(stdout)
+      << "runs " << runs.size() * qint64(repeat) << "  transitions "
+      << transitions << "  rejected " << rejected << "  endings " << endings
+      << "  elapsed ms " << QString::number(elapsedNs / 1e6, 'f', 2)
+      << "  transitions/s "
+      << QString::number(seconds > 0 ? transitions / seconds : 0.0, 'f', 0)
+      << "\n";
+  return 0;
+}
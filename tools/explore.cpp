@@ -0,0 +1,416 @@
+#include "storyloader.h"
+#include "storyrules.h"
+#include <QAtomicInteger>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+using State = QVector<int>;
+
+quint64 stateKey(const State &state) {
+  quint64 hash = 14695981039346656037ULL;
+  for (int value : state) {
+    hash ^= quint32(value);
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash ? hash : 1;
+}
+
+class VisitedSet {
+public:
+  enum Result { Inserted, Present, Full };
+
+  struct Entry {
+    qint64 parent = -1;
+    int node = -1;
+    int choice = -1;
+    int depth = 0;
+  };
+
+  explicit VisitedSet(qint64 maxStates)
+      : m_maxStates(qMax<qint64>(1, maxStates)) {
+    quint64 capacity = 16;
+    while (capacity < quint64(m_maxStates + m_maxStates / 2)) {
+      capacity <<= 1;
+    }
+    m_slots.reset(new Slot[capacity]());
+    m_mask = capacity - 1;
+  }
+
+  Result insert(quint64 key, const State &state, const Entry &entry,
+                qint64 &index) {
+    if (m_size.loadAcquire() >= m_maxStates) {
+      m_full.storeRelease(1);
+      return Full;
+    }
+
+    for (quint64 probe = key & m_mask;; probe = (probe + 1) & m_mask) {
+      Slot &slot = m_slots[probe];
+      quint64 current = slot.key.loadAcquire();
+      if (current == 0 && slot.key.testAndSetOrdered(0, key, current)) {
+        slot.state = state;
+        slot.entry = entry;
+        slot.ready.storeRelease(1);
+        m_size.fetchAndAddRelaxed(1);
+        m_stateBytes.fetchAndAddRelaxed(qint64(sizeof(QArrayData)) +
+                                        state.capacity() * sizeof(int));
+        index = qint64(probe);
+        return Inserted;
+      }
+      if (current == key) {
+        while (!slot.ready.loadAcquire()) {
+          QThread::yieldCurrentThread();
+        }
+        if (slot.state == state) {
+          index = qint64(probe);
+          return Present;
+        }
+        m_collisions.fetchAndAddRelaxed(1);
+      }
+    }
+  }
+
+  const Entry &entry(qint64 index) const { return m_slots[index].entry; }
+
+  qint64 size() const { return m_size.loadAcquire(); }
+  qint64 collisions() const { return m_collisions.loadAcquire(); }
+  bool isFull() const { return m_full.loadAcquire() != 0; }
+  qint64 memoryBytes() const {
+    return qint64(m_mask + 1) * sizeof(Slot) + m_stateBytes.loadAcquire();
+  }
+
+private:
+  struct Slot {
+    QAtomicInteger<quint64> key;
+    QAtomicInt ready;
+    State state;
+    Entry entry;
+  };
+
+  std::unique_ptr<Slot[]> m_slots;
+  quint64 m_mask = 0;
+  qint64 m_maxStates;
+  QAtomicInteger<qint64> m_size;
+  QAtomicInteger<qint64> m_collisions;
+  QAtomicInteger<qint64> m_stateBytes;
+  QAtomicInt m_full;
+};
+
+struct WorkItem {
+  State state;
+  qint64 index = -1;
+  int depth = 0;
+};
+
+struct Ending {
+  qint64 index = -1;
+  int depth = 0;
+};
+
+class Explorer {
+public:
+  Explorer(const StoryGraph &graph, qint64 maxStates, int statLimit,
+           bool trackInventory)
+      : m_graph(graph), m_rules(graph), m_visited(maxStates),
+        m_statLimit(qMax(0, statLimit)), m_trackInventory(trackInventory) {}
+
+  void run(int startNode, int threadCount) {
+    const int workerCount = qMax(1, threadCount);
+
+    WorkItem root;
+    root.state.append(startNode);
+    if (m_statLimit > 0) {
+      root.state += m_rules.initialStats();
+      clampStats(root.state);
+    }
+
+    VisitedSet::Entry entry;
+    entry.node = startNode;
+    m_visited.insert(stateKey(root.state), root.state, entry, root.index);
+    if (m_graph.node(startNode).isEndNode()) {
+      recordEnding(startNode, root.index, 0);
+      return;
+    }
+
+    QVector<WorkItem> frontier;
+    frontier.append(root);
+    std::unique_ptr<QVector<WorkItem>[]> next(
+        new QVector<WorkItem>[workerCount]);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workerCount);
+    while (!frontier.isEmpty()) {
+      m_frontier = &frontier;
+      m_cursor.storeRelease(0);
+      for (int worker = 0; worker < workerCount; ++worker) {
+        pool.start(new Worker(this, &next[worker]));
+      }
+      pool.waitForDone();
+
+      frontier.clear();
+      for (int worker = 0; worker < workerCount; ++worker) {
+        frontier += next[worker];
+        next[worker].clear();
+      }
+    }
+    m_frontier = nullptr;
+  }
+
+  const VisitedSet &visited() const { return m_visited; }
+  qint64 transitionCount() const { return m_transitionCount.loadAcquire(); }
+  const QMap<int, Ending> &endings() const { return m_endings; }
+
+  QVector<int> witness(qint64 index) const {
+    QVector<int> choices;
+    while (index >= 0) {
+      const VisitedSet::Entry &entry = m_visited.entry(index);
+      if (entry.choice < 0) {
+        break;
+      }
+      choices.append(entry.choice);
+      index = entry.parent;
+    }
+    std::reverse(choices.begin(), choices.end());
+    return choices;
+  }
+
+private:
+  class Worker : public QRunnable {
+  public:
+    Worker(Explorer *explorer, QVector<WorkItem> *next)
+        : m_explorer(explorer), m_next(next) {}
+
+    void run() override { m_explorer->work(*m_next); }
+
+  private:
+    Explorer *m_explorer;
+    QVector<WorkItem> *m_next;
+  };
+
+  void work(QVector<WorkItem> &next) {
+    qint64 transitions = 0;
+    for (;;) {
+      const int index = m_cursor.fetchAndAddRelaxed(1);
+      if (index >= m_frontier->size()) {
+        break;
+      }
+      transitions += expand(m_frontier->at(index), next);
+    }
+    m_transitionCount.fetchAndAddRelaxed(transitions);
+  }
+
+  int expand(const WorkItem &item, QVector<WorkItem> &next) {
+    const int node = item.state[0];
+    const int first = m_rules.firstTransition(node);
+    const int last = first + m_rules.transitionCount(node);
+    int expanded = 0;
+
+    for (int t = first; t < last; ++t) {
+      const StoryRules::Transition &transition = m_rules.transition(t);
+      if (transition.target < 0 ||
+          m_graph.node(transition.target).isRemoved()) {
+        continue;
+      }
+      ++expanded;
+
+      WorkItem child;
+      child.state = item.state;
+      child.state[0] = transition.target;
+      if (m_statLimit > 0) {
+        m_rules.applyStats(transition, child.state.data() + 1);
+        clampStats(child.state);
+        if (m_trackInventory) {
+          for (int i = 0; i < transition.itemCount; ++i) {
+            addItem(child.state, m_rules.item(transition.firstItem + i));
+          }
+        }
+      }
+      child.depth = item.depth + 1;
+
+      VisitedSet::Entry entry;
+      entry.parent = item.index;
+      entry.node = transition.target;
+      entry.choice = t - first;
+      entry.depth = child.depth;
+      if (m_visited.insert(stateKey(child.state), child.state, entry,
+                           child.index) != VisitedSet::Inserted) {
+        continue;
+      }
+
+      if (m_graph.node(transition.target).isEndNode()) {
+        recordEnding(transition.target, child.index, child.depth);
+        continue;
+      }
+
+      next.append(std::move(child));
+    }
+    return expanded;
+  }
+
+  void clampStats(State &state) const {
+    for (int stat = 1; stat <= m_graph.statCount(); ++stat) {
+      state[stat] = qBound(-m_statLimit, state[stat], m_statLimit);
+    }
+  }
+
+  void addItem(State &state, int item) const {
+    int pos = 1 + m_graph.statCount();
+    while (pos < state.size() && state[pos] < item) {
+      pos += 2;
+    }
+    if (pos < state.size() && state[pos] == item) {
+      state[pos + 1] = qMin(state[pos + 1] + 1, m_statLimit);
+    } else {
+      state.insert(pos, 2, 1);
+      state[pos] = item;
+    }
+  }
+
+  void recordEnding(int node, qint64 index, int depth) {
+    QMutexLocker locker(&m_endingsMutex);
+    auto it = m_endings.find(node);
+    if (it == m_endings.end()) {
+      m_endings.insert(node, {index, depth});
+    } else if (depth < it->depth) {
+      *it = {index, depth};
+    }
+  }
+
+  const StoryGraph &m_graph;
+  StoryRules m_rules;
+  VisitedSet m_visited;
+  int m_statLimit;
+  bool m_trackInventory;
+
+  const QVector<WorkItem> *m_frontier = nullptr;
+  QAtomicInt m_cursor;
+  QAtomicInteger<qint64> m_transitionCount;
+
+  QMutex m_endingsMutex;
+  QMap<int, Ending> m_endings;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("rencpp-explore");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Explores every reachable state of a story breadth first and reports "
+      "each reachable ending with a shortest witness choice sequence.");
+  parser.addHelpOption();
+  parser.addOption({{"j", "threads"}, "Worker threads.", "count",
+                    QString::number(QThread::idealThreadCount())});
+  parser.addOption({"max-states",
+                    "Stop expanding once <count> distinct states are known.",
+                    "count", "4000000"});
+  parser.addOption({"stat-limit",
+                    "Also track stats and inventory, clamped to "
+                    "[-<limit>, <limit>]. Choices never depend on them, so "
+                    "by default the state is the node alone.",
+                    "limit", "0"});
+  parser.addOption({"ignore-inventory",
+                    "With --stat-limit, leave the inventory out of the "
+                    "state."});
+  parser.addPositionalArgument(
+      "stories",
+      "Story JSON files; the first one defines title and start. Defaults to "
+      "the bundled story.",
+      "[<story.json>...]");
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  QStringList storyFiles = parser.positionalArguments();
+  if (storyFiles.isEmpty()) {
+    storyFiles = StoryLoader::defaultStoryFiles();
+  }
+
+  LoadedStory story = StoryLoader::loadStory(storyFiles);
+  if (story.hasErrors()) {
+    err << "rencpp-explore: " << story.errorString() << "\n";
+    return 1;
+  }
+
+  const StoryGraph &graph = *story.graph;
+  const int startNode = graph.findNode(story.startNodeId);
+  if (startNode < 0) {
+    err << "rencpp-explore: Start node not found: " << story.startNodeId
+        << "\n";
+    return 1;
+  }
+
+  const int threadCount = qMax(1, parser.value("threads").toInt());
+  Explorer explorer(graph, parser.value("max-states").toLongLong(),
+                    parser.value("stat-limit").toInt(),
+                    !parser.isSet("ignore-inventory"));
+
+  QElapsedTimer timer;
+  timer.start();
+  explorer.run(startNode, threadCount);
+  const double seconds = timer.nsecsElapsed() / 1e9;
+
+  const VisitedSet &visited = explorer.visited();
+  out << "States " << visited.size() << "  transitions "
+      << explorer.transitionCount() << "  threads " << threadCount
+      << "  elapsed ms " << QString::number(seconds * 1000.0, 'f', 1)
+      << "  states/s "
+      << QString::number(seconds > 0 ? visited.size() / seconds : 0.0, 'f', 0)
+      << "\n";
+  out << "Visited set " << visited.memoryBytes() << " bytes ("
+      << QString::number(double(visited.memoryBytes()) /
+                             qMax<qint64>(1, visited.size()),
+                         'f', 1)
+      << " bytes/state, " << visited.collisions() << " hash collisions)\n";
+  if (visited.isFull()) {
+    out << "State limit reached; the results below are incomplete.\n";
+  }
+
+  int endingCount = 0;
+  QStringList unreached;
+  for (int node = 0; node < graph.nodeCount(); ++node) {
+    if (graph.node(node).isEndNode()) {
+      ++endingCount;
+      if (!explorer.endings().contains(node)) {
+        unreached.append(graph.node(node).id());
+      }
+    }
+  }
+
+  const QMap<int, Ending> &endings = explorer.endings();
+  out << "Reachable endings " << endings.size() << " of " << endingCount
+      << "\n";
+  for (auto it = endings.cbegin(); it != endings.cend(); ++it) {
+    QStringList choices;
+    for (int choice : explorer.witness(it->index)) {
+      choices.append(QString::number(choice));
+    }
+    out << "  " << graph.node(it.key()).id() << "  depth " << it->depth
+        << "  choices " << choices.join(' ') << "\n";
+  }
+  if (!unreached.isEmpty()) {
+    unreached.sort();
+    out << "Unreached endings: " << unreached.join(", ") << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,197 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+
+namespace {
+
+struct Client {
+  QTcpSocket *socket = nullptr;
+  QRandomGenerator random;
+  QElapsedTimer timer;
+  int remaining = 0;
+  bool awaitingChoice = false;
+};
+
+class LoadGenerator : public QObject {
+public:
+  LoadGenerator(const QString &host, quint16 port, int sessions,
+                int transitions, quint32 seed)
+      : m_clients(sessions), m_running(sessions) {
+    m_latencies.reserve(qint64(sessions) * transitions);
+    for (int i = 0; i < sessions; ++i) {
+      Client &client = m_clients[i];
+      client.random.seed(seed + quint32(i));
+      client.remaining = transitions;
+      client.socket = new QTcpSocket(this);
+      client.socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+      connect(client.socket, &QTcpSocket::connected, this,
+              [this, i]() { send(m_clients[i], "{\"cmd\":\"restart\"}"); });
+      connect(client.socket, &QTcpSocket::readyRead, this,
+              [this, i]() { onReadyRead(m_clients[i]); });
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+      connect(client.socket, &QAbstractSocket::errorOccurred, this,
+              [this, i]() { fail(m_clients[i]); });
+#else
+      connect(client.socket,
+              QOverload<QAbstractSocket::SocketError>::of(
+                  &QAbstractSocket::error),
+              this, [this, i]() { fail(m_clients[i]); });
+#endif
+      client.socket->connectToHost(host, port);
+    }
+    m_elapsed.start();
+  }
+
+  const QVector<qint64> &latencies() const { return m_latencies; }
+  qint64 elapsedNs() const { return m_elapsedNs; }
+  int failures() const { return m_failures; }
+
+private:
+  void send(Client &client, const QByteArray &request) {
+    client.timer.start();
+    client.socket->write(request);
+    client.socket->write("\n");
+  }
+
+  void onReadyRead(Client &client) {
+    while (client.socket->canReadLine()) {
+      const QByteArray line = client.socket->readLine();
+      if (client.awaitingChoice) {
+        m_latencies.append(client.timer.nsecsElapsed());
+        --client.remaining;
+      }
+
+      const QJsonObject state = QJsonDocument::fromJson(line).object();
+      if (client.remaining <= 0) {
+        finish(client);
+        return;
+      }
+
+      const int choices = state.value("choices").toArray().size();
+      if (state.value("ended").toBool() || choices == 0) {
+        client.awaitingChoice = false;
+        send(client, "{\"cmd\":\"restart\"}");
+      } else {
+        client.awaitingChoice = true;
+        send(client, QString("{\"cmd\":\"makeChoice\",\"choice\":%1}")
+                         .arg(client.random.bounded(choices))
+                         .toUtf8());
+      }
+    }
+  }
+
+  void fail(Client &client) {
+    QTextStream(stderr) << "rencpp-loadgen: "
+                        << client.socket->errorString() << "\n";
+    ++m_failures;
+    finish(client);
+  }
+
+  void finish(Client &client) {
+    if (!client.socket) {
+      return;
+    }
+    client.socket->disconnect(this);
+    client.socket->abort();
+    client.socket = nullptr;
+    if (--m_running == 0) {
+      m_elapsedNs = m_elapsed.nsecsElapsed();
+      QCoreApplication::quit();
+    }
+  }
+
+  QVector<Client> m_clients;
+  QVector<qint64> m_latencies;
+  QElapsedTimer m_elapsed;
+  qint64 m_elapsedNs = 0;
+  int m_running;
+  int m_failures = 0;
+};
+
+QJsonObject requestInfo(const QString &host, quint16 port) {
+  QTcpSocket socket;
+  socket.connectToHost(host, port);
+  if (!socket.waitForConnected(5000)) {
+    return QJsonObject();
+  }
+  socket.write("{\"cmd\":\"info\"}\n");
+  while (!socket.canReadLine()) {
+    if (!socket.waitForReadyRead(5000)) {
+      return QJsonObject();
+    }
+  }
+  return QJsonDocument::fromJson(socket.readLine()).object();
+}
+
+double percentileUs(const QVector<qint64> &sorted, double p) {
+  if (sorted.isEmpty()) {
+    return 0.0;
+  }
+  return sorted[int(p * (sorted.size() - 1))] / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("rencpp-loadgen");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Drives a rencpp-server with many concurrent sessions making random "
+      "choices and reports transition latency and throughput.");
+  parser.addHelpOption();
+  parser.addOption({"host", "Server address.", "address", "127.0.0.1"});
+  parser.addOption({{"p", "port"}, "Server port.", "port", "7777"});
+  parser.addOption({{"c", "sessions"}, "Concurrent sessions.", "count",
+                    "100"});
+  parser.addOption({{"n", "transitions"}, "Choices made per session.",
+                    "count", "1000"});
+  parser.addOption({"seed", "Random seed.", "value", "1"});
+  parser.process(app);
+
+  QTextStream out(stdout);
+  const QString host = parser.value("host");
+  const quint16 port = quint16(parser.value("port").toUInt());
+  const QJsonObject info = requestInfo(host, port);
+  if (!info.value("ok").toBool()) {
+    QTextStream(stderr) << "rencpp-loadgen: No rencpp-server at " << host
+                        << ":" << port << "\n";
+    return 1;
+  }
+
+  const int sessions = qMax(1, parser.value("sessions").toInt());
+  LoadGenerator generator(host, port, sessions,
+                          qMax(1, parser.value("transitions").toInt()),
+                          parser.value("seed").toUInt());
+  app.exec();
+
+  QVector<qint64> latencies = generator.latencies();
+  std::sort(latencies.begin(), latencies.end());
+  const double seconds = generator.elapsedNs() / 1e9;
+  const double throughput = seconds > 0 ? latencies.size() / seconds : 0.0;
+  const int threads = qMax(1, info.value("threads").toInt());
+
+  out << "sessions  transitions  failures  transitions/s  p50 us  p99 us  "
+         "server threads  sessions/core  transitions/s/core\n";
+  out << QString("%1  %2  %3  %4  %5  %6  %7  %8  %9\n")
+             .arg(sessions, -8)
+             .arg(latencies.size(), 11)
+             .arg(generator.failures(), 8)
+             .arg(throughput, 13, 'f', 0)
+             .arg(percentileUs(latencies, 0.5), 6, 'f', 1)
+             .arg(percentileUs(latencies, 0.99), 6, 'f', 1)
+             .arg(threads, 14)
+             .arg(double(sessions) / threads, 13, 'f', 1)
+             .arg(throughput / threads, 18, 'f', 0);
+  return generator.failures() > 0 ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+#include "gameserver.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QHostAddress>
+#include <QTextStream>
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("rencpp-server");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Hosts many game sessions over one shared story. Clients send one JSON "
+      "object per line: {\"cmd\": \"state\" | \"loadStory\" | \"makeChoice\" "
+      "| \"goBack\" | \"restart\" | \"info\", \"choice\": <index>} and get "
+      "the session state back as one JSON line.");
+  parser.addHelpOption();
+  parser.addOption({"host", "Address to listen on.", "address", "127.0.0.1"});
+  parser.addOption({{"p", "port"}, "Port to listen on.", "port", "7777"});
+  parser.addOption({{"j", "threads"}, "Session worker threads.", "count",
+                    QString::number(QThread::idealThreadCount())});
+  parser.addPositionalArgument(
+      "stories",
+      "Story JSON files; the first one defines title and start. Defaults to "
+      "the bundled story.",
+      "[<story.json>...]");
+  parser.process(app);
+
+  QTextStream err(stderr);
+  QStringList storyFiles = parser.positionalArguments();
+  if (storyFiles.isEmpty()) {
+    storyFiles = StoryLoader::defaultStoryFiles();
+  }
+
+  QString errorMsg;
+  QSharedPointer<const Story> story =
+      Story::load(storyFiles, StoryLoadOptions(), errorMsg);
+  if (!story) {
+    err << "rencpp-server: " << errorMsg << "\n";
+    return 1;
+  }
+
+  GameServer server(story, parser.value("threads").toInt());
+  const QHostAddress address(parser.value("host"));
+  if (!server.listen(address, quint16(parser.value("port").toUInt()))) {
+    err << "rencpp-server: " << server.errorString() << "\n";
+    return 1;
+  }
+
+  QTextStream(stdout) << "Serving \"" << story->title() << "\" on "
+                      << address.toString() << ":" << server.serverPort()
+                      << " with " << server.threadCount()
+                      << " worker threads\n";
+  return app.exec();
+}
@@ -0,0 +1,446 @@
+#include "storyloader.h"
+#include "storyrules.h"
+#include <QAtomicInteger>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtMath>
+#include <limits>
+
+namespace {
+
+const qint64 RunsPerChunk = 1024;
+
+class CounterRng {
+public:
+  CounterRng(quint64 seed, quint64 stream)
+      : m_key(mix(seed ^ mix(stream + Golden))) {}
+
+  int below(int bound) {
+    const quint64 bits = mix(m_key + Golden * ++m_counter) >> 32;
+    return int((bits * quint64(bound)) >> 32);
+  }
+
+private:
+  static constexpr quint64 Golden = 0x9e3779b97f4a7c15ULL;
+
+  static quint64 mix(quint64 z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  quint64 m_key;
+  quint64 m_counter = 0;
+};
+
+struct StatSummary {
+  int minimum = std::numeric_limits<int>::max();
+  int maximum = std::numeric_limits<int>::min();
+  double sum = 0;
+  double sumSquares = 0;
+
+  void add(int value) {
+    minimum = qMin(minimum, value);
+    maximum = qMax(maximum, value);
+    sum += value;
+    sumSquares += double(value) * value;
+  }
+
+  void merge(const StatSummary &other) {
+    minimum = qMin(minimum, other.minimum);
+    maximum = qMax(maximum, other.maximum);
+    sum += other.sum;
+    sumSquares += other.sumSquares;
+  }
+};
+
+struct Tally {
+  QVector<qint64> endings;
+  QVector<StatSummary> endingStats;
+  QVector<qint64> lengths;
+  QVector<qint64> visits;
+  QVector<qint64> picks;
+  qint64 unfinished = 0;
+  qint64 stuck = 0;
+
+  Tally(int endingCount, int statCount, int maxSteps, int nodeCount,
+        int transitionCount)
+      : endings(endingCount), endingStats(endingCount * statCount),
+        lengths(maxSteps + 1), visits(nodeCount), picks(transitionCount) {}
+
+  void merge(const Tally &other) {
+    addCounts(endings, other.endings);
+    addCounts(lengths, other.lengths);
+    addCounts(visits, other.visits);
+    addCounts(picks, other.picks);
+    for (int i = 0; i < endingStats.size(); ++i) {
+      endingStats[i].merge(other.endingStats[i]);
+    }
+    unfinished += other.unfinished;
+    stuck += other.stuck;
+  }
+
+  static void addCounts(QVector<qint64> &into, const QVector<qint64> &from) {
+    for (int i = 0; i < into.size(); ++i) {
+      into[i] += from[i];
+    }
+  }
+};
+
+class Simulator {
+public:
+  Simulator(const StoryGraph &graph, int startNode, quint64 seed,
+            int maxSteps)
+      : m_rules(graph), m_startNode(startNode), m_seed(seed),
+        m_maxSteps(maxSteps), m_initialStats(m_rules.initialStats()),
+        m_endingIndex(graph.nodeCount(), -1) {
+    m_firstValid.reserve(graph.nodeCount() + 1);
+    for (int node = 0; node < graph.nodeCount(); ++node) {
+      m_firstValid.append(m_valid.size());
+      if (graph.node(node).isEndNode()) {
+        m_endingIndex[node] = m_endingNodes.size();
+        m_endingNodes.append(node);
+      }
+
+      const int first = m_rules.firstTransition(node);
+      for (int i = 0; i < m_rules.transitionCount(node); ++i) {
+        const int target = m_rules.transition(first + i).target;
+        if (target >= 0 && !graph.node(target).isRemoved()) {
+          m_valid.append(first + i);
+        }
+      }
+    }
+    m_firstValid.append(m_valid.size());
+  }
+
+  const StoryRules &rules() const { return m_rules; }
+  const QVector<int> &endingNodes() const { return m_endingNodes; }
+
+  Tally newTally() const {
+    return Tally(m_endingNodes.size(), m_rules.statCount(), m_maxSteps,
+                 m_rules.graph().nodeCount(), m_rules.totalTransitions());
+  }
+
+  Tally run(qint64 runCount, int threadCount) {
+    m_runCount = runCount;
+    m_nextChunk.storeRelease(0);
+    Tally total = newTally();
+    m_total = &total;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    for (int worker = 0; worker < threadCount; ++worker) {
+      pool.start(new Worker(this));
+    }
+    pool.waitForDone();
+
+    m_total = nullptr;
+    return total;
+  }
+
+  void play(qint64 run, Tally &tally, QVector<int> &stats,
+            QVector<int> *trace) const {
+    CounterRng rng(m_seed, quint64(run));
+    stats = m_initialStats;
+
+    int node = m_startNode;
+    int steps = 0;
+    while (m_endingIndex[node] < 0 && steps < m_maxSteps) {
+      const int first = m_firstValid[node];
+      const int count = m_firstValid[node + 1] - first;
+      if (count == 0) {
+        ++tally.stuck;
+        return;
+      }
+
+      const int index = m_valid[first + rng.below(count)];
+      const StoryRules::Transition &transition = m_rules.transition(index);
+      ++tally.visits[node];
+      ++tally.picks[index];
+      if (trace) {
+        trace->append(index - m_rules.firstTransition(node));
+      }
+
+      m_rules.applyStats(transition, stats.data());
+      node = transition.target;
+      ++steps;
+    }
+
+    const int ending = m_endingIndex[node];
+    if (ending < 0) {
+      ++tally.unfinished;
+      return;
+    }
+
+    ++tally.endings[ending];
+    ++tally.lengths[steps];
+    StatSummary *summaries =
+        tally.endingStats.data() + ending * m_rules.statCount();
+    for (int stat = 0; stat < stats.size(); ++stat) {
+      summaries[stat].add(stats[stat]);
+    }
+  }
+
+private:
+  class Worker : public QRunnable {
+  public:
+    explicit Worker(Simulator *simulator) : m_simulator(simulator) {}
+
+    void run() override { m_simulator->work(); }
+
+  private:
+    Simulator *m_simulator;
+  };
+
+  void work() {
+    Tally tally = newTally();
+    QVector<int> stats;
+    for (;;) {
+      const qint64 first = m_nextChunk.fetchAndAddRelaxed(RunsPerChunk);
+      if (first >= m_runCount) {
+        break;
+      }
+      const qint64 last = qMin(first + RunsPerChunk, m_runCount);
+      for (qint64 run = first; run < last; ++run) {
+        play(run, tally, stats, nullptr);
+      }
+    }
+
+    QMutexLocker locker(&m_mergeMutex);
+    m_total->merge(tally);
+  }
+
+  StoryRules m_rules;
+  int m_startNode;
+  quint64 m_seed;
+  int m_maxSteps;
+  QVector<int> m_initialStats;
+  QVector<int> m_endingIndex;
+  QVector<int> m_endingNodes;
+  QVector<int> m_firstValid;
+  QVector<int> m_valid;
+
+  qint64 m_runCount = 0;
+  QAtomicInteger<qint64> m_nextChunk;
+  QMutex m_mergeMutex;
+  Tally *m_total = nullptr;
+};
+
+int percentile(const QVector<qint64> &histogram, qint64 total, double p) {
+  const qint64 rank = qint64(p * (total - 1));
+  qint64 seen = 0;
+  for (int length = 0; length < histogram.size(); ++length) {
+    seen += histogram[length];
+    if (seen > rank) {
+      return length;
+    }
+  }
+  return histogram.size() - 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("rencpp-simulate");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Plays random playthroughs on all cores and reports ending, stat, "
+      "path length and choice distributions. Run N always makes the same "
+      "choices for a given seed, whatever the thread count.");
+  parser.addHelpOption();
+  parser.addOption({{"n", "runs"}, "Playthroughs to simulate.", "count",
+                    "1000000"});
+  parser.addOption({"seed", "Random seed.", "value", "1"});
+  parser.addOption({{"j", "threads"}, "Worker threads.", "count",
+                    QString::number(QThread::idealThreadCount())});
+  parser.addOption({"max-steps",
+                    "Abandon a playthrough after <count> choices.", "count",
+                    "10000"});
+  parser.addOption({"trace",
+                    "Print the choices of playthrough <run> and exit.", "run"});
+  parser.addOption({"output",
+                    "Write the full report, including per-choice pick rates, "
+                    "as JSON to <file>.",
+                    "file"});
+  parser.addPositionalArgument(
+      "stories",
+      "Story JSON files; the first one defines title and start. Defaults to "
+      "the bundled story.",
+      "[<story.json>...]");
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  QStringList storyFiles = parser.positionalArguments();
+  if (storyFiles.isEmpty()) {
+    storyFiles = StoryLoader::defaultStoryFiles();
+  }
+
+  LoadedStory story = StoryLoader::loadStory(storyFiles);
+  if (story.hasErrors()) {
+    err << "rencpp-simulate: " << story.errorString() << "\n";
+    return 1;
+  }
+
+  const StoryGraph &graph = *story.graph;
+  const int startNode = graph.findNode(story.startNodeId);
+  if (startNode < 0) {
+    err << "rencpp-simulate: Start node not found: " << story.startNodeId
+        << "\n";
+    return 1;
+  }
+
+  const quint64 seed = parser.value("seed").toULongLong();
+  const int maxSteps = qMax(1, parser.value("max-steps").toInt());
+  Simulator simulator(graph, startNode, seed, maxSteps);
+
+  if (parser.isSet("trace")) {
+    Tally tally = simulator.newTally();
+    QVector<int> stats;
+    QVector<int> trace;
+    simulator.play(parser.value("trace").toLongLong(), tally, stats, &trace);
+
+    QStringList choices;
+    for (int choice : qAsConst(trace)) {
+      choices.append(QString::number(choice));
+    }
+    out << choices.join(' ') << "\n";
+    return 0;
+  }
+
+  const qint64 runs = qMax<qint64>(1, parser.value("runs").toLongLong());
+  const int threadCount = qMax(1, parser.value("threads").toInt());
+
+  QElapsedTimer timer;
+  timer.start();
+  const Tally tally = simulator.run(runs, threadCount);
+  const double seconds = timer.nsecsElapsed() / 1e9;
+
+  qint64 finished = 0;
+  double lengthSum = 0;
+  for (int length = 0; length < tally.lengths.size(); ++length) {
+    finished += tally.lengths[length];
+    lengthSum += double(tally.lengths[length]) * length;
+  }
+
+  out << "Runs " << runs << "  finished " << finished << "  unfinished "
+      << tally.unfinished << "  stuck " << tally.stuck << "  threads "
+      << threadCount << "  elapsed ms "
+      << QString::number(seconds * 1000.0, 'f', 1) << "  runs/s "
+      << QString::number(seconds > 0 ? runs / seconds : 0.0, 'f', 0) << "\n";
+  if (finished > 0) {
+    out << "Path length  mean "
+        << QString::number(lengthSum / finished, 'f', 1) << "  p50 "
+        << percentile(tally.lengths, finished, 0.5) << "  p90 "
+        << percentile(tally.lengths, finished, 0.9) << "  p99 "
+        << percentile(tally.lengths, finished, 0.99) << "  max "
+        << percentile(tally.lengths, finished, 1.0) << "\n";
+  }
+
+  const int statCount = simulator.rules().statCount();
+  QJsonArray endingsJson;
+  out << "Endings\n";
+  for (int ending = 0; ending < simulator.endingNodes().size(); ++ending) {
+    const qint64 count = tally.endings[ending];
+    const QString id = graph.node(simulator.endingNodes()[ending]).id();
+
+    QStringList statText;
+    QJsonObject statsJson;
+    for (int stat = 0; stat < statCount && count > 0; ++stat) {
+      const StatSummary &summary =
+          tally.endingStats[ending * statCount + stat];
+      const double mean = summary.sum / count;
+      const double variance =
+          qMax(0.0, summary.sumSquares / count - mean * mean);
+      const QString statId = graph.statDefinition(stat).id;
+      statText.append(QString("%1 %2 [%3..%4]")
+                          .arg(graph.statDefinition(stat).name)
+                          .arg(mean, 0, 'f', 1)
+                          .arg(summary.minimum)
+                          .arg(summary.maximum));
+
+      QJsonObject statJson;
+      statJson["mean"] = mean;
+      statJson["stddev"] = qSqrt(variance);
+      statJson["min"] = summary.minimum;
+      statJson["max"] = summary.maximum;
+      statsJson[statId] = statJson;
+    }
+
+    if (count > 0) {
+      out << "  " << id << "  " << count << "  "
+          << QString::number(100.0 * count / runs, 'f', 2) << "%  "
+          << statText.join(", ") << "\n";
+    }
+
+    QJsonObject endingJson;
+    endingJson["id"] = id;
+    endingJson["count"] = count;
+    endingJson["share"] = double(count) / runs;
+    endingJson["stats"] = statsJson;
+    endingsJson.append(endingJson);
+  }
+
+  if (!parser.isSet("output")) {
+    return 0;
+  }
+
+  QJsonArray choicesJson;
+  const StoryRules &rules = simulator.rules();
+  for (int node = 0; node < graph.nodeCount(); ++node) {
+    const qint64 visits = tally.visits[node];
+    if (visits == 0) {
+      continue;
+    }
+    const int first = rules.firstTransition(node);
+    for (int choice = 0; choice < rules.transitionCount(node); ++choice) {
+      QJsonObject choiceJson;
+      choiceJson["node"] = graph.node(node).id();
+      choiceJson["choice"] = choice;
+      choiceJson["picks"] = tally.picks[first + choice];
+      choiceJson["rate"] = double(tally.picks[first + choice]) / visits;
+      choicesJson.append(choiceJson);
+    }
+  }
+
+  QJsonArray lengthsJson;
+  for (qint64 count : tally.lengths) {
+    lengthsJson.append(count);
+  }
+
+  QJsonObject report;
+  report["runs"] = runs;
+  report["seed"] = QString::number(seed);
+  report["threads"] = threadCount;
+  report["seconds"] = seconds;
+  report["finished"] = finished;
+  report["unfinished"] = tally.unfinished;
+  report["stuck"] = tally.stuck;
+  report["endings"] = endingsJson;
+  report["pathLengths"] = lengthsJson;
+  report["choices"] = choicesJson;
+
+  QFile file(parser.value("output"));
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(QJsonDocument(report).toJson()) < 0) {
+    err << "rencpp-simulate: Failed to write " << parser.value("output")
+        << "\n";
+    return 1;
+  }
+  return 0;
+}